@@ -0,0 +1,260 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Пакет матриц одной формы с чередующимся хранением
+//
+
+#ifndef __TBatch_H__
+#define __TBatch_H__
+
+#include "tmatrix.h"
+
+// Пакет матриц -
+// count матриц rows x cols в одном блоке памяти; элемент (i, j) всех матриц
+// лежит подряд: a[b](i, j) = mem[(i * cols + j) * count + b], поэтому ядра
+// векторизуются по номеру матрицы в пакете; пакет векторов - пакет матриц n x 1
+template<typename T>
+class TMatrixBatch
+{
+  size_t nCount, nRows, nCols;
+  TDynamicVector<T> mem;
+
+  // матрицы обрабатываются полосами по LANES, полосы - параллельно
+  static constexpr size_t LANES = 256;
+
+  static size_t checkedSize(size_t count, size_t rows, size_t cols)
+  {
+    if (count == 0 || rows == 0 || cols == 0)
+      throw out_of_range("Batch size should be greater than zero");
+    if (rows > MAX_MATRIX_SIZE || cols > MAX_MATRIX_SIZE)
+      throw out_of_range("Matrix size should be not greater than MAX_MATRIX_SIZE");
+    // проверка до умножения: произведение могло бы переполниться
+    if (count > MAX_VECTOR_SIZE / (rows * cols))
+      throw out_of_range("Batch size should be not greater than MAX_VECTOR_SIZE");
+    return count * rows * cols;
+  }
+  const T* lane(size_t i, size_t j) const noexcept { return lane(mem.data(), i, j); }
+  T* lane(size_t i, size_t j) noexcept { return lane(mem.data(), i, j); }
+  // элемент (i, j) всех матриц от начала буфера p; в параллельных ядрах p берётся
+  // заранее: неконстантный data() может отделять общий буфер (копирование при записи)
+  template<typename P>
+  P* lane(P* p, size_t i, size_t j) const noexcept { return p + (i * nCols + j) * nCount; }
+
+  // f(first, last) по полосам матриц; work - число операций на одну матрицу
+  template<typename F>
+  void forLanes(size_t work, F f) const
+  {
+    size_t grain = max<size_t>(LANES, TParallel::GRAIN / max<size_t>(work, 1));
+    TParallel::forRange(nCount, grain, [&](size_t first, size_t last) {
+      for (size_t b = first; b < last; b += LANES)
+        f(b, min(last, b + LANES));
+    });
+  }
+  void checkShape(const TMatrixBatch& m) const
+  {
+    if (nCount != m.nCount || nRows != m.nRows || nCols != m.nCols)
+      throw out_of_range("different size");
+  }
+public:
+  TMatrixBatch(size_t count, size_t rows, size_t cols)
+    : nCount(count), nRows(rows), nCols(cols), mem(checkedSize(count, rows, cols)) {}
+
+  size_t count() const noexcept { return nCount; }
+  size_t rows() const noexcept { return nRows; }
+  size_t cols() const noexcept { return nCols; }
+  T* data() noexcept { return mem.data(); }
+  const T* data() const noexcept { return mem.data(); }
+
+  // индексация
+  T& operator()(size_t b, size_t i, size_t j) noexcept { return lane(i, j)[b]; }
+  const T& operator()(size_t b, size_t i, size_t j) const noexcept { return lane(i, j)[b]; }
+  T& at(size_t b, size_t i, size_t j)
+  {
+    if (b >= nCount || i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    return (*this)(b, i, j);
+  }
+  const T& at(size_t b, size_t i, size_t j) const
+  {
+    if (b >= nCount || i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    return (*this)(b, i, j);
+  }
+
+  // представления без копирования: b-я матрица и элемент (i, j) всех матриц
+  TMatrixView<T> matrix(size_t b)
+  {
+    if (b >= nCount)
+      throw out_of_range("bad index");
+    return TMatrixView<T>(mem.data() + b, nRows, nCols, (ptrdiff_t)(nCols * nCount), (ptrdiff_t)nCount);
+  }
+  TMatrixView<const T> matrix(size_t b) const
+  {
+    if (b >= nCount)
+      throw out_of_range("bad index");
+    return TMatrixView<const T>(mem.data() + b, nRows, nCols, (ptrdiff_t)(nCols * nCount), (ptrdiff_t)nCount);
+  }
+  TVectorView<T> lanes(size_t i, size_t j)
+  {
+    if (i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    return TVectorView<T>(lane(i, j), nCount);
+  }
+  TVectorView<const T> lanes(size_t i, size_t j) const
+  {
+    if (i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    return TVectorView<const T>(lane(i, j), nCount);
+  }
+
+  // поэлементные операции над всем пакетом
+  TMatrixBatch& operator+=(const TMatrixBatch& m)
+  {
+    checkShape(m);
+    mem.view() += m.mem.view();
+    return *this;
+  }
+  TMatrixBatch& operator-=(const TMatrixBatch& m)
+  {
+    checkShape(m);
+    mem.view() -= m.mem.view();
+    return *this;
+  }
+  TMatrixBatch& operator*=(const T& val)
+  {
+    mem.view() *= val;
+    return *this;
+  }
+  TMatrixBatch operator+(const TMatrixBatch& m) const
+  {
+    TMatrixBatch res(*this);
+    return res += m;
+  }
+  TMatrixBatch operator-(const TMatrixBatch& m) const
+  {
+    TMatrixBatch res(*this);
+    return res -= m;
+  }
+
+  // попарные произведения: res[b] = this[b] * m[b]
+  // (при m.cols() == 1 - пакетное матрично-векторное произведение)
+  TMatrixBatch operator*(const TMatrixBatch& m) const
+  {
+    if (nCount != m.nCount || nCols != m.nRows)
+      throw out_of_range("different size");
+    TMatrixBatch res(nCount, nRows, m.nCols);
+    T* pr = res.data();
+    forLanes(nRows * nCols * m.nCols, [&](size_t first, size_t last) {
+      for (size_t i = 0; i < nRows; i++)
+        for (size_t k = 0; k < nCols; k++)
+        {
+          const T* x = lane(i, k);
+          for (size_t j = 0; j < m.nCols; j++)
+          {
+            const T* y = m.lane(k, j);
+            T* r = res.lane(pr, i, j);
+            for (size_t b = first; b < last; b++)
+              r[b] = r[b] + x[b] * y[b];
+          }
+        }
+    });
+    return res;
+  }
+  // все матрицы пакета на один вектор: res[b] = this[b] * v
+  TMatrixBatch operator*(TVectorView<const T> v) const
+  {
+    if (nCols != v.size())
+      throw out_of_range("different size");
+    TMatrixBatch res(nCount, nRows, 1);
+    T* pr = res.data();
+    forLanes(nRows * nCols, [&](size_t first, size_t last) {
+      for (size_t i = 0; i < nRows; i++)
+      {
+        T* r = res.lane(pr, i, 0);
+        for (size_t k = 0; k < nCols; k++)
+        {
+          const T* x = lane(i, k);
+          const T vk = v[k];
+          for (size_t b = first; b < last; b++)
+            r[b] = r[b] + x[b] * vk;
+        }
+      }
+    });
+    return res;
+  }
+
+  // решение систем this[b] X[b] = rhs[b] методом Гаусса с выбором ведущего элемента
+  // в каждой матрице; перестановки строк делаются поэлементно, исключение - по полосе
+  TMatrixBatch solve(const TMatrixBatch& rhs) const
+  {
+    size_t n = nRows;
+    if (nCols != n)
+      throw out_of_range("matrix is not square");
+    if (rhs.nCount != nCount || rhs.nRows != n)
+      throw out_of_range("different size");
+    size_t k = rhs.nCols;
+    TMatrixBatch a(*this), x(rhs);
+    T* pa = a.data();
+    T* px = x.data();
+    forLanes(n * n * (n + k), [&](size_t first, size_t last) {
+      T f[LANES];
+      for (size_t c = 0; c < n; c++)
+      {
+        for (size_t b = first; b < last; b++)
+        {
+          size_t p = c;
+          for (size_t i = c + 1; i < n; i++)
+            if (absValue(a.lane(pa, p, c)[b]) < absValue(a.lane(pa, i, c)[b]))
+              p = i;
+          if (a.lane(pa, p, c)[b] == T())
+            throw runtime_error("singular matrix");
+          if (p != c)
+          {
+            for (size_t j = c; j < n; j++)
+              swap(a.lane(pa, c, j)[b], a.lane(pa, p, j)[b]);
+            for (size_t j = 0; j < k; j++)
+              swap(x.lane(px, c, j)[b], x.lane(px, p, j)[b]);
+          }
+        }
+        const T* d = a.lane(pa, c, c);
+        for (size_t i = c + 1; i < n; i++)
+        {
+          const T* e = a.lane(pa, i, c);
+          for (size_t b = first; b < last; b++)
+            f[b - first] = e[b] / d[b];
+          for (size_t j = c + 1; j < n; j++)
+          {
+            T* r = a.lane(pa, i, j);
+            const T* s = a.lane(pa, c, j);
+            for (size_t b = first; b < last; b++)
+              r[b] = r[b] - f[b - first] * s[b];
+          }
+          for (size_t j = 0; j < k; j++)
+          {
+            T* r = x.lane(px, i, j);
+            const T* s = x.lane(px, c, j);
+            for (size_t b = first; b < last; b++)
+              r[b] = r[b] - f[b - first] * s[b];
+          }
+        }
+      }
+      for (size_t c = n; c-- > 0;)
+        for (size_t j = 0; j < k; j++)
+        {
+          T* r = x.lane(px, c, j);
+          for (size_t i = c + 1; i < n; i++)
+          {
+            const T* u = a.lane(pa, c, i);
+            const T* s = x.lane(px, i, j);
+            for (size_t b = first; b < last; b++)
+              r[b] = r[b] - u[b] * s[b];
+          }
+          const T* d = a.lane(pa, c, c);
+          for (size_t b = first; b < last; b++)
+            r[b] = r[b] / d[b];
+        }
+    });
+    return x;
+  }
+};
+
+#endif
@@ -0,0 +1,128 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Кэш результатов дорогих матричных операций
+//
+
+#ifndef __TCache_H__
+#define __TCache_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <typeindex>
+#include <unordered_map>
+
+// Операции, результаты которых запоминаются
+enum class TMemoOp : uint32_t { Multiply, Inverse, LU };
+
+// ключ: операция, тип элементов и 128-битные хеши содержимого операндов
+struct TMemoKey
+{
+  TMemoOp op;
+  uint32_t flags; // порядок хранения результата и т.п.
+  std::type_index type;
+  uint64_t a[2], b[2];
+
+  bool operator==(const TMemoKey& k) const noexcept
+  {
+    return op == k.op && flags == k.flags && type == k.type &&
+      a[0] == k.a[0] && a[1] == k.a[1] && b[0] == k.b[0] && b[1] == k.b[1];
+  }
+};
+
+// Кэш результатов -
+// один на процесс, выключен по умолчанию; вытесняются давно не использованные
+// результаты (LRU), пока их общий размер больше бюджета; потокобезопасен
+class TMemoCache
+{
+  struct TKeyHash
+  {
+    size_t operator()(const TMemoKey& k) const noexcept
+    {
+      return (size_t)(k.a[0] ^ (k.b[0] * 0x9E3779B97F4A7C15ull) ^ ((uint64_t)k.op << 32) ^ k.type.hash_code());
+    }
+  };
+  struct TEntry
+  {
+    TMemoKey key;
+    std::shared_ptr<const void> value;
+    size_t bytes;
+  };
+
+  mutable std::mutex m;
+  std::list<TEntry> entries; // в начале - последние использованные
+  std::unordered_map<TMemoKey, std::list<TEntry>::iterator, TKeyHash> index;
+  size_t limit = 256u << 20, used = 0, nHits = 0, nMisses = 0;
+
+  TMemoCache() = default;
+
+  void evict() noexcept
+  {
+    while (used > limit && !entries.empty())
+    {
+      used -= entries.back().bytes;
+      index.erase(entries.back().key);
+      entries.pop_back();
+    }
+  }
+public:
+  static inline bool enabled = false;
+
+  static TMemoCache& instance()
+  {
+    static TMemoCache cache;
+    return cache;
+  }
+
+  // бюджет памяти под результаты, байт
+  void setBudget(size_t bytes)
+  {
+    std::lock_guard<std::mutex> lock(m);
+    limit = bytes;
+    evict();
+  }
+  size_t budget() const { std::lock_guard<std::mutex> lock(m); return limit; }
+  size_t bytes() const { std::lock_guard<std::mutex> lock(m); return used; }
+  size_t size() const { std::lock_guard<std::mutex> lock(m); return entries.size(); }
+  size_t hits() const { std::lock_guard<std::mutex> lock(m); return nHits; }
+  size_t misses() const { std::lock_guard<std::mutex> lock(m); return nMisses; }
+  void clear()
+  {
+    std::lock_guard<std::mutex> lock(m);
+    entries.clear();
+    index.clear();
+    used = nHits = nMisses = 0;
+  }
+
+  // результат по ключу; при промахе вычисляется compute() (вне блокировки)
+  // и запоминается, если bytes укладывается в бюджет
+  template<typename V, typename F>
+  std::shared_ptr<const V> getOrCompute(const TMemoKey& key, size_t bytes, F compute)
+  {
+    {
+      std::lock_guard<std::mutex> lock(m);
+      auto it = index.find(key);
+      if (it != index.end())
+      {
+        nHits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return std::static_pointer_cast<const V>(it->second->value);
+      }
+      nMisses++;
+    }
+    std::shared_ptr<const V> res = std::make_shared<const V>(compute());
+    std::lock_guard<std::mutex> lock(m);
+    if (bytes <= limit && index.find(key) == index.end())
+    {
+      entries.push_front(TEntry{ key, res, bytes });
+      index.emplace(key, entries.begin());
+      used += bytes;
+      evict();
+    }
+    return res;
+  }
+};
+
+#endif
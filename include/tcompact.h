@@ -0,0 +1,312 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Компактные типы элементов: IEEE fp16, bfloat16 и int8 с масштабом на строку
+//
+
+#ifndef __TCompact_H__
+#define __TCompact_H__
+
+#include <cmath>
+#include <cstring>
+#include "tmatrix.h"
+
+#if defined(__F16C__)
+#include <immintrin.h>
+#endif
+
+// Половинная точность IEEE 754 (binary16) -
+// хранится 2 байта, арифметика выполняется во float
+struct THalf
+{
+  uint16_t bits;
+
+  THalf() = default;
+  THalf(float f) noexcept : bits(fromFloat(f)) {}
+  operator float() const noexcept { return toFloat(bits); }
+
+  static THalf fromBits(uint16_t b) noexcept
+  {
+    THalf h;
+    h.bits = b;
+    return h;
+  }
+  // округление к ближайшему чётному, переполнение -> бесконечность
+  static uint16_t fromFloat(float f) noexcept
+  {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    uint32_t sign = x & 0x80000000u;
+    x ^= sign;
+    uint32_t o;
+    if (x >= (143u << 23)) // >= 2^16, Inf или NaN
+      o = x > (255u << 23) ? 0x7e00 : 0x7c00;
+    else if (x < (113u << 23)) // денормализованные и ноль
+    {
+      float a, magic = 0.5f;
+      memcpy(&a, &x, sizeof(a));
+      a += magic;
+      memcpy(&o, &a, sizeof(o));
+      o -= 126u << 23;
+    }
+    else
+    {
+      uint32_t mantOdd = (x >> 13) & 1;
+      x += ((uint32_t)(15 - 127) << 23) + 0xfff + mantOdd;
+      o = x >> 13;
+    }
+    return (uint16_t)(o | (sign >> 16));
+  }
+  static float toFloat(uint16_t h) noexcept
+  {
+    const uint32_t shiftedExp = 0x7c00u << 13;
+    uint32_t o = (uint32_t)(h & 0x7fff) << 13;
+    uint32_t exp = shiftedExp & o;
+    o += (uint32_t)(127 - 15) << 23;
+    if (exp == shiftedExp) // Inf/NaN
+      o += (uint32_t)(128 - 16) << 23;
+    else if (exp == 0) // денормализованные и ноль
+    {
+      float f, magic;
+      uint32_t m = 113u << 23;
+      o += 1u << 23;
+      memcpy(&f, &o, sizeof(f));
+      memcpy(&magic, &m, sizeof(magic));
+      f -= magic;
+      memcpy(&o, &f, sizeof(o));
+    }
+    o |= (uint32_t)(h & 0x8000) << 16;
+    float f;
+    memcpy(&f, &o, sizeof(f));
+    return f;
+  }
+
+  friend istream& operator>>(istream& istr, THalf& h)
+  {
+    float f;
+    if (istr >> f)
+      h = THalf(f);
+    return istr;
+  }
+};
+
+// bfloat16 - старшие 16 бит float, тот же диапазон при 8 битах мантиссы
+struct TBFloat16
+{
+  uint16_t bits;
+
+  TBFloat16() = default;
+  TBFloat16(float f) noexcept : bits(fromFloat(f)) {}
+  operator float() const noexcept { return toFloat(bits); }
+
+  static TBFloat16 fromBits(uint16_t b) noexcept
+  {
+    TBFloat16 h;
+    h.bits = b;
+    return h;
+  }
+  static uint16_t fromFloat(float f) noexcept
+  {
+    uint32_t x;
+    memcpy(&x, &f, sizeof(x));
+    if ((x & 0x7fffffffu) > 0x7f800000u) // NaN остаётся тихим NaN
+      return (uint16_t)((x >> 16) | 0x40);
+    x += 0x7fff + ((x >> 16) & 1);
+    return (uint16_t)(x >> 16);
+  }
+  static float toFloat(uint16_t b) noexcept
+  {
+    uint32_t x = (uint32_t)b << 16;
+    float f;
+    memcpy(&f, &x, sizeof(f));
+    return f;
+  }
+
+  friend istream& operator>>(istream& istr, TBFloat16& h)
+  {
+    float f;
+    if (istr >> f)
+      h = TBFloat16(f);
+    return istr;
+  }
+};
+
+// правила приведения: компактный тип с float/double даёт float/double
+namespace std
+{
+  template<> struct common_type<THalf, float> { using type = float; };
+  template<> struct common_type<float, THalf> { using type = float; };
+  template<> struct common_type<THalf, double> { using type = double; };
+  template<> struct common_type<double, THalf> { using type = double; };
+  template<> struct common_type<TBFloat16, float> { using type = float; };
+  template<> struct common_type<float, TBFloat16> { using type = float; };
+  template<> struct common_type<TBFloat16, double> { using type = double; };
+  template<> struct common_type<double, TBFloat16> { using type = double; };
+  template<> struct common_type<THalf, TBFloat16> { using type = float; };
+  template<> struct common_type<TBFloat16, THalf> { using type = float; };
+}
+
+// суммы по компактным типам копятся во float
+template<> struct TAccumulator<THalf> { using type = float; };
+template<> struct TAccumulator<TBFloat16> { using type = float; };
+
+// пакетное преобразование в/из float
+template<>
+struct TConvertKernel<float, THalf>
+{
+  static void run(const THalf* src, float* dst, size_t n)
+  {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8)
+      _mm256_storeu_ps(dst + i, _mm256_cvtph_ps(_mm_loadu_si128((const __m128i*)(src + i))));
+#endif
+    for (; i < n; i++)
+      dst[i] = THalf::toFloat(src[i].bits);
+  }
+};
+template<>
+struct TConvertKernel<THalf, float>
+{
+  static void run(const float* src, THalf* dst, size_t n)
+  {
+    size_t i = 0;
+#if defined(__F16C__)
+    for (; i + 8 <= n; i += 8)
+      _mm_storeu_si128((__m128i*)(dst + i), _mm256_cvtps_ph(_mm256_loadu_ps(src + i), _MM_FROUND_TO_NEAREST_INT));
+#endif
+    for (; i < n; i++)
+      dst[i].bits = THalf::fromFloat(src[i]);
+  }
+};
+template<>
+struct TConvertKernel<float, TBFloat16>
+{
+  static void run(const TBFloat16* src, float* dst, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      dst[i] = TBFloat16::toFloat(src[i].bits);
+  }
+};
+template<>
+struct TConvertKernel<TBFloat16, float>
+{
+  static void run(const float* src, TBFloat16* dst, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      dst[i].bits = TBFloat16::fromFloat(src[i]);
+  }
+};
+
+// скалярное произведение компактных массивов: блоки расширяются во float
+// пакетным преобразованием, произведения копятся в double (W); суммы блоков
+// сводятся TReduction::sum - выбранным способом и параллельно для длинных массивов
+template<typename Acc, typename A, typename B>
+struct TCompactDotKernel
+{
+  static constexpr size_t BLOCK = 256;
+  using W = conditional_t<is_floating_point<Acc>::value, common_type_t<Acc, double>, Acc>;
+
+  static const float* widen(const float* src, float*, size_t) { return src; }
+  template<typename X>
+  static const float* widen(const X* src, float* buf, size_t n)
+  {
+    TConvertKernel<float, X>::run(src, buf, n);
+    return buf;
+  }
+
+  static Acc run(const A* a, const B* b, size_t n)
+  {
+    W res = TReduction::sum<W>((n + BLOCK - 1) / BLOCK, [a, b, n](size_t k) {
+      float bufA[BLOCK], bufB[BLOCK];
+      size_t i = k * BLOCK, len = std::min(BLOCK, n - i);
+      const float* x = widen(a + i, bufA, len);
+      const float* y = widen(b + i, bufB, len);
+      return TReduction::sum<W>(len, [x, y](size_t j) { return (W)x[j] * (W)y[j]; });
+    });
+    return (Acc)res;
+  }
+};
+template<typename Acc> struct TDotKernel<Acc, THalf, THalf> : TCompactDotKernel<Acc, THalf, THalf> {};
+template<typename Acc> struct TDotKernel<Acc, THalf, float> : TCompactDotKernel<Acc, THalf, float> {};
+template<typename Acc> struct TDotKernel<Acc, float, THalf> : TCompactDotKernel<Acc, float, THalf> {};
+template<typename Acc> struct TDotKernel<Acc, TBFloat16, TBFloat16> : TCompactDotKernel<Acc, TBFloat16, TBFloat16> {};
+template<typename Acc> struct TDotKernel<Acc, TBFloat16, float> : TCompactDotKernel<Acc, TBFloat16, float> {};
+template<typename Acc> struct TDotKernel<Acc, float, TBFloat16> : TCompactDotKernel<Acc, float, TBFloat16> {};
+
+
+// Квантованная матрица -
+// элементы int8 и масштаб на строку: a(i, j) ~= scale[i] * q(i, j)
+class TQuantizedMatrix
+{
+  size_t nRows, nCols;
+  TDynamicVector<int8_t> q;
+  TDynamicVector<float> scales;
+
+  // симметричное квантование строки: max|x| отображается в 127
+  template<typename X>
+  static float quantize(const X* src, ptrdiff_t step, size_t n, int8_t* dst)
+  {
+    float amax = 0.0f;
+    for (size_t j = 0; j < n; j++)
+      amax = std::max(amax, std::abs((float)src[(ptrdiff_t)j * step]));
+    float scale = amax > 0.0f ? amax / 127.0f : 1.0f;
+    float inv = 1.0f / scale;
+    for (size_t j = 0; j < n; j++)
+    {
+      float r = (float)src[(ptrdiff_t)j * step] * inv;
+      dst[j] = (int8_t)(r < 0.0f ? r - 0.5f : r + 0.5f);
+    }
+    return scale;
+  }
+public:
+  explicit TQuantizedMatrix(TMatrixView<const float> m)
+    : nRows(m.rows()), nCols(m.cols()), q(m.rows() * m.cols()), scales(m.rows())
+  {
+    for (size_t i = 0; i < nRows; i++)
+      scales[i] = quantize(&m(i, 0), m.colStride(), nCols, q.data() + i * nCols);
+  }
+
+  size_t rows() const noexcept { return nRows; }
+  size_t cols() const noexcept { return nCols; }
+  float scale(size_t i) const { return scales.at(i); }
+  TVectorView<const int8_t> row(size_t i) const
+  {
+    if (i >= nRows)
+      throw out_of_range("bad index");
+    return TVectorView<const int8_t>(q.data() + i * nCols, nCols);
+  }
+
+  TDynamicMatrix<float> dequantize() const
+  {
+    TDynamicMatrix<float> res(nRows, nCols);
+    for (size_t i = 0; i < nRows; i++)
+      for (size_t j = 0; j < nCols; j++)
+        res[i][j] = scales[i] * (float)q[i * nCols + j];
+    return res;
+  }
+
+  // матрично-векторное произведение: int8 расширяется во float построчно
+  TDynamicVector<float> operator*(TVectorView<const float> v) const
+  {
+    if (v.size() != nCols)
+      throw out_of_range("bad size");
+    TDynamicVector<float> res(nRows);
+    for (size_t i = 0; i < nRows; i++)
+      res[i] = scales[i] * (float)row(i).dot<float>(v);
+    return res;
+  }
+  // вектор тоже квантуется в int8, произведения копятся в int32
+  TDynamicVector<float> multiplyQuantized(TVectorView<const float> v) const
+  {
+    if (v.size() != nCols)
+      throw out_of_range("bad size");
+    TDynamicVector<int8_t> qv(nCols);
+    float vScale = quantize(v.data(), v.stride(), nCols, qv.data());
+    TDynamicVector<float> res(nRows);
+    for (size_t i = 0; i < nRows; i++)
+      res[i] = scales[i] * vScale * (float)TDotKernel<int32_t, int8_t, int8_t>::run(q.data() + i * nCols, qv.data(), nCols);
+    return res;
+  }
+};
+
+#endif
@@ -0,0 +1,399 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Матрица во внешней памяти: плитки в файле и ограниченный кэш плиток
+//
+
+#ifndef __TDisk_H__
+#define __TDisk_H__
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include "tmatrix.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+// Матрица во внешней памяти -
+// элементы хранятся в файле квадратными плитками tile x tile (по строкам внутри плитки,
+// плитки - по строкам сетки, крайние дополнены нулями), в памяти - не больше бюджета
+// кэша плиток; давно не использованные плитки вытесняются (LRU), изменённые при этом
+// записываются в файл. Плитки в кэше не изменяются: запись заменяет плитку целиком,
+// поэтому ядра читают плитки без блокировок. Размер не ограничен MAX_MATRIX_SIZE -
+// только диском; новый файл создаётся разреженным (нулевые плитки не занимают места)
+template<typename T>
+class TDiskMatrix
+{
+  static_assert(is_trivially_copyable<T>::value, "disk matrix requires trivially copyable T");
+
+  using TTile = TDynamicMatrix<T>;
+  using TTileRef = shared_ptr<const TTile>;
+  struct TEntry
+  {
+    size_t id;
+    TTileRef tile;
+    bool dirty;
+  };
+  // заголовок файла, данные - с HEADER байт
+  struct THeader
+  {
+    char magic[8];
+    uint64_t elemSize, rows, cols, tile;
+  };
+
+  string filePath;
+  size_t nRows, nCols, t, gridRows, gridCols;
+#if defined(__linux__)
+  int fd = -1;
+#else
+  mutable fstream file;
+  mutable mutex io;
+#endif
+  mutable mutex m;
+  mutable list<TEntry> entries; // в начале - последние использованные
+  mutable unordered_map<size_t, typename list<TEntry>::iterator> index;
+  size_t limit = 256u << 20;
+  mutable size_t used = 0, nHits = 0, nMisses = 0;
+
+  size_t tileBytes() const noexcept { return t * t * sizeof(T); }
+  uint64_t offset(size_t id) const noexcept { return HEADER + (uint64_t)id * tileBytes(); }
+
+  void readRaw(uint64_t pos, void* dst, size_t n) const
+  {
+#if defined(__linux__)
+    char* p = static_cast<char*>(dst);
+    while (n)
+    {
+      ssize_t got = pread(fd, p, n, (off_t)pos);
+      if (got <= 0)
+        throw runtime_error("cannot read " + filePath);
+      p += got;
+      pos += (uint64_t)got;
+      n -= (size_t)got;
+    }
+#else
+    lock_guard<mutex> lock(io);
+    file.seekg((streamoff)pos);
+    file.read(static_cast<char*>(dst), (streamsize)n);
+    if (!file)
+      throw runtime_error("cannot read " + filePath);
+#endif
+  }
+  void writeRaw(uint64_t pos, const void* src, size_t n) const
+  {
+#if defined(__linux__)
+    const char* p = static_cast<const char*>(src);
+    while (n)
+    {
+      ssize_t put = pwrite(fd, p, n, (off_t)pos);
+      if (put <= 0)
+        throw runtime_error("cannot write " + filePath);
+      p += put;
+      pos += (uint64_t)put;
+      n -= (size_t)put;
+    }
+#else
+    lock_guard<mutex> lock(io);
+    file.seekp((streamoff)pos);
+    file.write(static_cast<const char*>(src), (streamsize)n);
+    if (!file)
+      throw runtime_error("cannot write " + filePath);
+#endif
+  }
+  void openFile(bool create)
+  {
+#if defined(__linux__)
+    fd = open(filePath.c_str(), create ? O_RDWR | O_CREAT | O_TRUNC : O_RDWR, 0644);
+    if (fd < 0)
+      throw runtime_error("cannot open " + filePath);
+#else
+    file.open(filePath, ios::in | ios::out | ios::binary | (create ? ios::trunc : ios::openmode()));
+    if (!file)
+      throw runtime_error("cannot open " + filePath);
+#endif
+  }
+  void closeFile() noexcept
+  {
+#if defined(__linux__)
+    if (fd >= 0)
+      close(fd);
+    fd = -1;
+#else
+    file.close();
+#endif
+  }
+  void initGrid(size_t rows, size_t cols, size_t tile)
+  {
+    if (rows == 0 || cols == 0)
+      throw out_of_range("Matrix size should be greater than zero");
+    if (tile == 0 || tile > MAX_MATRIX_SIZE)
+      throw out_of_range("bad tile size");
+    nRows = rows;
+    nCols = cols;
+    t = tile;
+    gridRows = (rows + tile - 1) / tile;
+    gridCols = (cols + tile - 1) / tile;
+  }
+
+  // вытеснение под m: изменённые плитки записываются до удаления из кэша,
+  // поэтому следующий промах по ним прочитает уже новые данные
+  void evict() const
+  {
+    while (used > limit && !entries.empty())
+    {
+      TEntry& e = entries.back();
+      if (e.dirty)
+        writeRaw(offset(e.id), e.tile->view().data(), tileBytes());
+      used -= tileBytes();
+      index.erase(e.id);
+      entries.pop_back();
+    }
+  }
+  void put(size_t id, TTileRef tile, bool dirty) const
+  {
+    lock_guard<mutex> lock(m);
+    auto it = index.find(id);
+    if (it != index.end())
+    {
+      if (!dirty) // прочитана параллельно с другим промахом - остаётся прежняя
+        return;
+      it->second->tile = std::move(tile);
+      it->second->dirty = true;
+      entries.splice(entries.begin(), entries, it->second);
+      return;
+    }
+    if (!dirty && tileBytes() > limit)
+      return;
+    entries.push_front(TEntry{ id, std::move(tile), dirty });
+    index.emplace(id, entries.begin());
+    used += tileBytes();
+    evict();
+  }
+public:
+  static constexpr size_t DEFAULT_TILE = 1024;
+  static constexpr size_t HEADER = 4096;
+
+  // новая нулевая матрица в файле path (существующий файл перезаписывается)
+  TDiskMatrix(const string& path, size_t rows, size_t cols, size_t tile = DEFAULT_TILE) : filePath(path)
+  {
+    initGrid(rows, cols, tile);
+    openFile(true);
+    // деструктор не вызывается для недостроенного объекта - файл закрывается здесь
+    try
+    {
+      THeader h = { { 'T', 'D', 'I', 'S', 'K', 'M', 'A', 'T' }, sizeof(T), rows, cols, tile };
+      char page[HEADER] = {};
+      memcpy(page, &h, sizeof(h));
+      writeRaw(0, page, HEADER);
+      char zero = 0; // последний байт задаёт длину файла, остальное - дыры
+      writeRaw(offset(gridRows * gridCols) - 1, &zero, 1);
+    }
+    catch (...)
+    {
+      closeFile();
+      throw;
+    }
+  }
+  // существующая матрица
+  explicit TDiskMatrix(const string& path) : filePath(path)
+  {
+    openFile(false);
+    try
+    {
+      THeader h;
+      readRaw(0, &h, sizeof(h));
+      if (memcmp(h.magic, "TDISKMAT", 8) != 0 || h.elemSize != sizeof(T))
+        throw runtime_error("bad disk matrix file " + path);
+      initGrid((size_t)h.rows, (size_t)h.cols, (size_t)h.tile);
+    }
+    catch (...)
+    {
+      closeFile();
+      throw;
+    }
+  }
+  TDiskMatrix(const TDiskMatrix&) = delete;
+  TDiskMatrix& operator=(const TDiskMatrix&) = delete;
+  ~TDiskMatrix()
+  {
+    try
+    {
+      flush();
+    }
+    catch (...)
+    {
+    }
+    closeFile();
+  }
+
+  size_t rows() const noexcept { return nRows; }
+  size_t cols() const noexcept { return nCols; }
+  size_t tileSize() const noexcept { return t; }
+  size_t tileRows() const noexcept { return gridRows; }
+  size_t tileCols() const noexcept { return gridCols; }
+  const string& path() const noexcept { return filePath; }
+
+  // бюджет кэша плиток, байт
+  void setCacheBudget(size_t bytes)
+  {
+    lock_guard<mutex> lock(m);
+    limit = bytes;
+    evict();
+  }
+  size_t cacheBudget() const { lock_guard<mutex> lock(m); return limit; }
+  size_t cacheBytes() const { lock_guard<mutex> lock(m); return used; }
+  size_t hits() const { lock_guard<mutex> lock(m); return nHits; }
+  size_t misses() const { lock_guard<mutex> lock(m); return nMisses; }
+  // записать изменённые плитки в файл
+  void flush()
+  {
+    lock_guard<mutex> lock(m);
+    for (TEntry& e : entries)
+      if (e.dirty)
+      {
+        writeRaw(offset(e.id), e.tile->view().data(), tileBytes());
+        e.dirty = false;
+      }
+  }
+
+  // плитка (ti, tj) целиком, вместе с нулевым дополнением; остаётся действительной,
+  // пока на неё есть ссылка, даже после вытеснения
+  TTileRef tile(size_t ti, size_t tj) const
+  {
+    if (ti >= gridRows || tj >= gridCols)
+      throw out_of_range("bad tile index");
+    size_t id = ti * gridCols + tj;
+    {
+      lock_guard<mutex> lock(m);
+      auto it = index.find(id);
+      if (it != index.end())
+      {
+        nHits++;
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->tile;
+      }
+      nMisses++;
+    }
+    shared_ptr<TTile> res = make_shared<TTile>(t, t);
+    readRaw(offset(id), res->view().data(), tileBytes());
+    put(id, res, false);
+    return res;
+  }
+  // заменить плитку (ti, tj); src - полная плитка t x t с нулевым дополнением
+  void storeTile(size_t ti, size_t tj, TTile&& src)
+  {
+    if (ti >= gridRows || tj >= gridCols)
+      throw out_of_range("bad tile index");
+    if (src.rows() != t || src.cols() != t || src.layout() != TMatrixLayout::RowMajor)
+      throw out_of_range("bad tile size");
+    put(ti * gridCols + tj, make_shared<const TTile>(std::move(src)), true);
+  }
+
+  T get(size_t i, size_t j) const
+  {
+    if (i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    return (*tile(i / t, j / t))[i % t][j % t];
+  }
+  // записать блок src с позиции (r0, c0)
+  void assign(TMatrixView<const T> src, size_t r0 = 0, size_t c0 = 0)
+  {
+    if (r0 + src.rows() > nRows || c0 + src.cols() > nCols)
+      throw out_of_range("bad block");
+    for (size_t ti = r0 / t; ti * t < r0 + src.rows(); ti++)
+      for (size_t tj = c0 / t; tj * t < c0 + src.cols(); tj++)
+      {
+        size_t i0 = max(r0, ti * t), i1 = min(r0 + src.rows(), (ti + 1) * t);
+        size_t j0 = max(c0, tj * t), j1 = min(c0 + src.cols(), (tj + 1) * t);
+        TTile x = (i1 - i0 == t && j1 - j0 == t) ? TTile(t, t) : TTile(*tile(ti, tj));
+        x.block(i0 - ti * t, j0 - tj * t, i1 - i0, j1 - j0).assign(src.block(i0 - r0, j0 - c0, i1 - i0, j1 - j0));
+        storeTile(ti, tj, std::move(x));
+      }
+  }
+  // копия блока в памяти
+  TDynamicMatrix<T> read(size_t r0, size_t c0, size_t rows, size_t cols) const
+  {
+    if (r0 + rows > nRows || c0 + cols > nCols)
+      throw out_of_range("bad block");
+    TDynamicMatrix<T> res(rows, cols);
+    for (size_t ti = r0 / t; ti * t < r0 + rows; ti++)
+      for (size_t tj = c0 / t; tj * t < c0 + cols; tj++)
+      {
+        size_t i0 = max(r0, ti * t), i1 = min(r0 + rows, (ti + 1) * t);
+        size_t j0 = max(c0, tj * t), j1 = min(c0 + cols, (tj + 1) * t);
+        TTileRef x = tile(ti, tj);
+        res.block(i0 - r0, j0 - c0, i1 - i0, j1 - j0).assign(x->view().block(i0 - ti * t, j0 - tj * t, i1 - i0, j1 - j0));
+      }
+    return res;
+  }
+
+  // матрично-векторное произведение: полосы плиток - параллельно
+  TDynamicVector<T> operator*(TVectorView<const T> v) const
+  {
+    if (v.size() != nCols)
+      throw out_of_range("bad size");
+    TDynamicVector<T> res(nRows);
+    TVectorView<T> all = res.view();
+    TParallel::forEach(gridRows, [&](size_t ti) {
+      size_t h = min(t, nRows - ti * t);
+      TVectorView<T> r = all.slice(ti * t, h);
+      for (size_t tj = 0; tj < gridCols; tj++)
+      {
+        size_t w = min(t, nCols - tj * t);
+        TTileRef x = tile(ti, tj);
+        r += x->view().block(0, 0, h, w) * v.slice(tj * t, w);
+      }
+    });
+    return res;
+  }
+
+  // c = a + b по плиткам
+  static void add(const TDiskMatrix& a, const TDiskMatrix& b, TDiskMatrix& c)
+  {
+    if (a.nRows != b.nRows || a.nCols != b.nCols || c.nRows != a.nRows || c.nCols != a.nCols)
+      throw out_of_range("different size");
+    checkTiles(a, b, c);
+    TParallel::forEach(c.gridRows * c.gridCols, [&](size_t id) {
+      size_t ti = id / c.gridCols, tj = id % c.gridCols;
+      TTileRef y = b.tile(ti, tj);
+      TTile x(*a.tile(ti, tj));
+      x.view() += y->view();
+      c.storeTile(ti, tj, std::move(x));
+    });
+  }
+  // c = a * b: плитка результата копится по k ядром addProduct; c не должна совпадать с a или b
+  static void multiply(const TDiskMatrix& a, const TDiskMatrix& b, TDiskMatrix& c)
+  {
+    if (a.nCols != b.nRows || c.nRows != a.nRows || c.nCols != b.nCols)
+      throw out_of_range("different size");
+    checkTiles(a, b, c);
+    if (&c == &a || &c == &b)
+      throw invalid_argument("result aliases an operand");
+    TParallel::forEach(c.gridRows * c.gridCols, [&](size_t id) {
+      size_t ti = id / c.gridCols, tj = id % c.gridCols;
+      TTile acc(c.t, c.t);
+      for (size_t k = 0; k < a.gridCols; k++)
+      {
+        TTileRef x = a.tile(ti, k), y = b.tile(k, tj);
+        acc.view().addProduct(x->view(), y->view());
+      }
+      c.storeTile(ti, tj, std::move(acc));
+    });
+  }
+
+private:
+  static void checkTiles(const TDiskMatrix& a, const TDiskMatrix& b, const TDiskMatrix& c)
+  {
+    if (a.t != b.t || a.t != c.t)
+      throw out_of_range("different tile size");
+  }
+};
+
+#endif
@@ -0,0 +1,272 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Обмен матрицами в текстовых форматах: CSV и Matrix Market
+//
+
+#ifndef __TFormat_H__
+#define __TFormat_H__
+
+#include <cctype>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "tmatrix.h"
+#include "tsparse.h"
+#include "ttext.h"
+
+// CSV - строка файла на строку матрицы, числа через разделитель;
+// число столбцов - по первой строке, строк - сколько прочитано;
+// первая строка с нечисловыми полями считается заголовком и пропускается,
+// поля в кавычках допускаются
+struct TCsv
+{
+  template<typename T>
+  static TDynamicMatrix<T> read(istream& istr, char sep = ',', TMatrixLayout layout = TMatrixLayout::RowMajor)
+  {
+    TTextReader in(istr);
+    vector<T> values;
+    size_t cols = 0, rows = 0;
+    bool header = true;
+    while (in.peek() != TTextReader::END)
+    {
+      if (in.atEol()) // пустые строки пропускаются
+      {
+        in.skipLine();
+        continue;
+      }
+      size_t start = values.size(), line = in.lineNo();
+      bool ok = true;
+      for (;;)
+      {
+        in.skipBlanks();
+        bool quoted = in.peek() == '"';
+        if (quoted)
+          in.get();
+        T x;
+        if (!in.number(x, sep) || (quoted && in.get() != '"'))
+        {
+          ok = false;
+          break;
+        }
+        values.push_back(x);
+        if (in.atEol())
+          break;
+        if (in.get() != sep)
+        {
+          ok = false;
+          break;
+        }
+      }
+      if (!ok)
+      {
+        if (!header)
+          throw runtime_error("bad CSV field in line " + to_string(line));
+        values.resize(start);
+        header = false;
+        in.skipLine();
+        continue;
+      }
+      header = false;
+      size_t n = values.size() - start;
+      if (rows == 0)
+        cols = n;
+      else if (n != cols)
+        throw runtime_error("bad CSV: line " + to_string(line) + " has " + to_string(n) + " fields");
+      rows++;
+      in.skipLine();
+    }
+    if (rows == 0)
+      throw runtime_error("empty CSV");
+    TDynamicMatrix<T> res(rows, cols, layout);
+    res.view().assign(TMatrixView<const T>(values.data(), rows, cols, (ptrdiff_t)cols));
+    return res;
+  }
+
+  template<typename T>
+  static void write(ostream& ostr, TMatrixView<const T> m, char sep = ',')
+  {
+    TTextWriter out(ostr);
+    for (size_t i = 0; i < m.rows(); i++)
+    {
+      for (size_t j = 0; j < m.cols(); j++)
+      {
+        if (j)
+          out.put(sep);
+        out.number(m(i, j));
+      }
+      out.put('\n');
+    }
+  }
+
+  template<typename T>
+  static TDynamicMatrix<T> load(const string& path, char sep = ',')
+  {
+    ifstream f(path, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    return read<T>(f, sep);
+  }
+  template<typename T>
+  static void save(const string& path, TMatrixView<const T> m, char sep = ',')
+  {
+    ofstream f(path, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    write(f, m, sep);
+    f.flush();
+    if (!f)
+      throw runtime_error("cannot write " + path);
+  }
+};
+
+// Matrix Market - заголовок "%%MatrixMarket matrix <формат> <поле> <симметрия>",
+// строки комментариев "%", строка размеров и элементы:
+// array - все элементы по столбцам, coordinate - тройки "i j x" с индексами от 1;
+// поддерживаются поля real, double, integer, pattern и симметрии general, symmetric, skew-symmetric
+struct TMatrixMarket
+{
+  struct THeader
+  {
+    bool coordinate = false;
+    bool pattern = false;
+    int symmetry = 0; // 0 - general, 1 - symmetric, -1 - skew-symmetric
+    size_t rows = 0, cols = 0, nnz = 0;
+  };
+
+  static THeader readHeader(TTextReader& in)
+  {
+    THeader h;
+    if (in.word() != "%%MatrixMarket" || in.word() != "matrix")
+      throw runtime_error("bad Matrix Market header");
+    string format = in.word(), field = in.word(), symmetry = in.word();
+    for (string* s : { &format, &field, &symmetry })
+      for (char& c : *s)
+        c = (char)tolower((unsigned char)c);
+    if (format != "coordinate" && format != "array")
+      throw runtime_error("unsupported Matrix Market format " + format);
+    if (field != "real" && field != "double" && field != "integer" && field != "pattern")
+      throw runtime_error("unsupported Matrix Market field " + field);
+    if (symmetry != "general" && symmetry != "symmetric" && symmetry != "skew-symmetric")
+      throw runtime_error("unsupported Matrix Market symmetry " + symmetry);
+    h.coordinate = format == "coordinate";
+    h.pattern = field == "pattern";
+    h.symmetry = symmetry == "general" ? 0 : symmetry == "symmetric" ? 1 : -1;
+    if (h.pattern && !h.coordinate)
+      throw runtime_error("pattern field requires coordinate format");
+    in.skipLine();
+    while (in.peek() == '%' || in.atEol())
+      if (!in.skipLine())
+        throw runtime_error("missing Matrix Market size line");
+    if (!in.number(h.rows) || !in.number(h.cols) || (h.coordinate && !in.number(h.nnz)) || !in.atEol())
+      throw runtime_error("bad Matrix Market size line");
+    if (h.rows == 0 || h.cols == 0 || (h.symmetry && h.rows != h.cols))
+      throw runtime_error("bad Matrix Market size");
+    if (!h.coordinate)
+      h.nnz = h.symmetry ? h.rows * (h.rows + 1) / 2 - (h.symmetry < 0 ? h.rows : 0) : h.rows * h.cols;
+    return h;
+  }
+
+  // f(i, j, x) для каждого элемента файла, включая отражённые симметрией
+  template<typename T, typename F>
+  static void readEntries(TTextReader& in, const THeader& h, F f)
+  {
+    size_t i = !h.coordinate && h.symmetry < 0, j = 0; // без диагонали для skew-symmetric
+    for (size_t k = 0; k < h.nnz; k++)
+    {
+      while (in.atEol()) // пустые строки между элементами
+        if (!in.skipLine())
+          throw runtime_error("unexpected end of Matrix Market data");
+      T x = T(1);
+      if (h.coordinate)
+      {
+        if (!in.number(i) || !in.number(j) || i == 0 || j == 0 || i > h.rows || j > h.cols)
+          throw runtime_error("bad Matrix Market entry in line " + to_string(in.lineNo()));
+        i--;
+        j--;
+      }
+      if ((!h.pattern && !in.number(x)) || !in.atEol())
+        throw runtime_error("bad Matrix Market entry in line " + to_string(in.lineNo()));
+      in.skipLine();
+      f(i, j, x);
+      if (h.symmetry && i != j)
+        f(j, i, h.symmetry > 0 ? x : (T)-x);
+      if (!h.coordinate) // по столбцам, для симметричных - нижний треугольник
+        if (++i == h.rows)
+        {
+          j++;
+          i = h.symmetry ? j + (h.symmetry < 0) : 0;
+        }
+    }
+  }
+
+  template<typename T>
+  static TDynamicMatrix<T> readDense(istream& istr, TMatrixLayout layout = TMatrixLayout::RowMajor)
+  {
+    TTextReader in(istr);
+    THeader h = readHeader(in);
+    TDynamicMatrix<T> res(h.rows, h.cols, layout);
+    TMatrixView<T> m = res.view();
+    if (!h.coordinate && h.symmetry < 0)
+      readEntries<T>(in, h, [&m](size_t i, size_t j, T x) { m(i, j) = x; });
+    else
+      readEntries<T>(in, h, [&m](size_t i, size_t j, T x) { m(i, j) = m(i, j) + x; });
+    return res;
+  }
+  template<typename T>
+  static TSparseMatrix<T> readSparse(istream& istr)
+  {
+    TTextReader in(istr);
+    THeader h = readHeader(in);
+    TSparseMatrix<T> res(h.rows, h.cols);
+    res.reserve(h.coordinate ? h.nnz * (h.symmetry ? 2 : 1) : 0);
+    readEntries<T>(in, h, [&res](size_t i, size_t j, T x) {
+      if (x != T())
+        res.add(i, j, x);
+    });
+    return res;
+  }
+
+  template<typename T>
+  static void writeDense(ostream& ostr, TMatrixView<const T> m)
+  {
+    TTextWriter out(ostr);
+    out.put("%%MatrixMarket matrix array " + field<T>() + " general\n");
+    out.number(m.rows());
+    out.put(' ');
+    out.number(m.cols());
+    out.put('\n');
+    for (size_t j = 0; j < m.cols(); j++)
+      for (size_t i = 0; i < m.rows(); i++)
+      {
+        out.number(m(i, j));
+        out.put('\n');
+      }
+  }
+  template<typename T>
+  static void writeSparse(ostream& ostr, const TSparseMatrix<T>& m)
+  {
+    TTextWriter out(ostr);
+    out.put("%%MatrixMarket matrix coordinate " + field<T>() + " general\n");
+    out.number(m.rows());
+    out.put(' ');
+    out.number(m.cols());
+    out.put(' ');
+    out.number(m.nnz());
+    out.put('\n');
+    for (const typename TSparseMatrix<T>::TEntry& e : m)
+    {
+      out.number(e.row + 1);
+      out.put(' ');
+      out.number(e.col + 1);
+      out.put(' ');
+      out.number(e.value);
+      out.put('\n');
+    }
+  }
+
+private:
+  template<typename T>
+  static string field() { return is_integral<T>::value ? "integer" : "real"; }
+};
+
+#endif
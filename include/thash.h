@@ -0,0 +1,227 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Хеши и контрольные суммы потока байтов
+//
+
+#ifndef __THash_H__
+#define __THash_H__
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+// 64-битный хеш xxHash64 (совместим с эталонной реализацией XXH64);
+// данные подаются частями через update, результат - digest
+class THash64
+{
+  static constexpr uint64_t P1 = 0x9E3779B185EBCA87ull;
+  static constexpr uint64_t P2 = 0xC2B2AE3D27D4EB4Full;
+  static constexpr uint64_t P3 = 0x165667B19E3779F9ull;
+  static constexpr uint64_t P4 = 0x85EBCA77C2B2AE63ull;
+  static constexpr uint64_t P5 = 0x27D4EB2F165667C5ull;
+
+  uint64_t seed, total = 0;
+  uint64_t acc[4];
+  unsigned char buf[32];
+  size_t bufLen = 0;
+
+  static uint64_t rotl(uint64_t x, int r) noexcept { return (x << r) | (x >> (64 - r)); }
+  static uint64_t read64(const unsigned char* p) noexcept
+  {
+    uint64_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+  }
+  static uint32_t read32(const unsigned char* p) noexcept
+  {
+    uint32_t x;
+    memcpy(&x, p, sizeof(x));
+    return x;
+  }
+  static uint64_t round(uint64_t a, uint64_t x) noexcept { return rotl(a + x * P2, 31) * P1; }
+  static uint64_t merge(uint64_t h, uint64_t a) noexcept { return (h ^ round(0, a)) * P1 + P4; }
+  // полосы по 32 байта: четыре независимых накопителя
+  void stripes(const unsigned char* p, size_t n) noexcept
+  {
+    uint64_t a0 = acc[0], a1 = acc[1], a2 = acc[2], a3 = acc[3];
+    for (size_t i = 0; i < n; i += 32)
+    {
+      a0 = round(a0, read64(p + i));
+      a1 = round(a1, read64(p + i + 8));
+      a2 = round(a2, read64(p + i + 16));
+      a3 = round(a3, read64(p + i + 24));
+    }
+    acc[0] = a0; acc[1] = a1; acc[2] = a2; acc[3] = a3;
+  }
+public:
+  explicit THash64(uint64_t s = 0) noexcept : seed(s)
+  {
+    acc[0] = s + P1 + P2;
+    acc[1] = s + P2;
+    acc[2] = s;
+    acc[3] = s - P1;
+  }
+
+  THash64& update(const void* data, size_t n) noexcept
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    total += n;
+    if (bufLen + n < 32)
+    {
+      if (n)
+        memcpy(buf + bufLen, p, n);
+      bufLen += n;
+      return *this;
+    }
+    if (bufLen)
+    {
+      size_t k = 32 - bufLen;
+      memcpy(buf + bufLen, p, k);
+      stripes(buf, 32);
+      p += k;
+      n -= k;
+      bufLen = 0;
+    }
+    size_t body = n / 32 * 32;
+    stripes(p, body);
+    memcpy(buf, p + body, n - body);
+    bufLen = n - body;
+    return *this;
+  }
+  template<typename T>
+  THash64& updateValue(const T& x) noexcept { return update(&x, sizeof(x)); }
+
+  uint64_t digest() const noexcept
+  {
+    uint64_t h;
+    if (total >= 32)
+    {
+      h = rotl(acc[0], 1) + rotl(acc[1], 7) + rotl(acc[2], 12) + rotl(acc[3], 18);
+      for (uint64_t a : acc)
+        h = merge(h, a);
+    }
+    else
+      h = seed + P5;
+    h += total;
+    size_t i = 0;
+    for (; i + 8 <= bufLen; i += 8)
+      h = rotl(h ^ round(0, read64(buf + i)), 27) * P1 + P4;
+    if (i + 4 <= bufLen)
+    {
+      h = rotl(h ^ (uint64_t)read32(buf + i) * P1, 23) * P2 + P3;
+      i += 4;
+    }
+    for (; i < bufLen; i++)
+      h = rotl(h ^ buf[i] * P5, 11) * P1;
+    h ^= h >> 33;
+    h *= P2;
+    h ^= h >> 29;
+    h *= P3;
+    h ^= h >> 32;
+    return h;
+  }
+};
+
+// Контрольная сумма CRC32C (полином Кастаньоли, как в iSCSI/ext4);
+// с SSE4.2 - аппаратной инструкцией crc32 по 8 байт
+class TCrc32c
+{
+  uint32_t crc = 0xFFFFFFFFu;
+
+  static const uint32_t* table() noexcept
+  {
+    struct TTable
+    {
+      uint32_t t[256];
+      TTable() noexcept
+      {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+          uint32_t c = i;
+          for (int k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ 0x82F63B78u : c >> 1;
+          t[i] = c;
+        }
+      }
+    };
+    static const TTable tbl;
+    return tbl.t;
+  }
+public:
+  TCrc32c& update(const void* data, size_t n) noexcept
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    size_t i = 0;
+#if defined(__SSE4_2__) && defined(__x86_64__)
+    uint64_t c = crc;
+    for (; i + 8 <= n; i += 8)
+    {
+      uint64_t x;
+      memcpy(&x, p + i, sizeof(x));
+      c = _mm_crc32_u64(c, x);
+    }
+    crc = (uint32_t)c;
+    for (; i < n; i++)
+      crc = _mm_crc32_u8(crc, p[i]);
+#else
+    const uint32_t* t = table();
+    for (; i < n; i++)
+      crc = t[(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+#endif
+    return *this;
+  }
+  uint32_t digest() const noexcept { return ~crc; }
+};
+
+// Контрольная сумма CRC32 (полином IEEE 802.3, как в zip и gzip);
+// таблицы на 8 байт за шаг (slicing-by-8)
+class TCrc32
+{
+  uint32_t crc = 0xFFFFFFFFu;
+
+  static const uint32_t (*table() noexcept)[256]
+  {
+    struct TTable
+    {
+      uint32_t t[8][256];
+      TTable() noexcept
+      {
+        for (uint32_t i = 0; i < 256; i++)
+        {
+          uint32_t c = i;
+          for (int k = 0; k < 8; k++)
+            c = c & 1 ? (c >> 1) ^ 0xEDB88320u : c >> 1;
+          t[0][i] = c;
+        }
+        for (uint32_t i = 0; i < 256; i++)
+          for (int k = 1; k < 8; k++)
+            t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+      }
+    };
+    static const TTable tbl;
+    return tbl.t;
+  }
+public:
+  TCrc32& update(const void* data, size_t n) noexcept
+  {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    const uint32_t (*t)[256] = table();
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8)
+    {
+      uint32_t lo = crc ^ ((uint32_t)p[i] | (uint32_t)p[i + 1] << 8 | (uint32_t)p[i + 2] << 16 | (uint32_t)p[i + 3] << 24);
+      crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+        t[3][p[i + 4]] ^ t[2][p[i + 5]] ^ t[1][p[i + 6]] ^ t[0][p[i + 7]];
+    }
+    for (; i < n; i++)
+      crc = t[0][(crc ^ p[i]) & 0xFF] ^ (crc >> 8);
+    return *this;
+  }
+  uint32_t digest() const noexcept { return ~crc; }
+};
+
+#endif
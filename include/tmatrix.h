@@ -10,14 +10,1130 @@
 #include <iostream>
 #include <stdexcept>
 #include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <limits>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility>
+#include <vector>
+#include "tcache.h"
+#include "thash.h"
+#include "tmemory.h"
+#include "tparallel.h"
+#include "ttext.h"
 
 using namespace std;
 
 const int MAX_VECTOR_SIZE = 100000000;
 const int MAX_MATRIX_SIZE = 10000;
 
-// Динамический вектор - 
+template<typename T> class TVectorView;
+template<typename T> class TMatrixView;
+template<typename T> class TDynamicVector;
+template<typename T> class TDynamicMatrix;
+
+// Порядок хранения элементов матрицы
+enum class TMatrixLayout { RowMajor, ColMajor };
+
+// Признаки векторных и матричных операндов и тип их элементов
+template<typename V> struct TVectorOperand : false_type {};
+template<typename T> struct TVectorOperand<TDynamicVector<T>> : true_type { using elem = T; };
+template<typename T> struct TVectorOperand<TVectorView<T>> : true_type { using elem = remove_const_t<T>; };
+template<typename M> struct TMatrixOperand : false_type {};
+template<typename T> struct TMatrixOperand<TDynamicMatrix<T>> : true_type { using elem = T; };
+template<typename T> struct TMatrixOperand<TMatrixView<T>> : true_type { using elem = remove_const_t<T>; };
+template<typename U> using TIsScalarOperand =
+  integral_constant<bool, !TVectorOperand<U>::value && !TMatrixOperand<U>::value>;
+
+// Правила приведения типов элементов:
+// - два вектора/матрицы с разными T дают общий тип (common_type);
+// - скаляр не расширяет тип элементов, кроме вещественного скаляра при целых элементах
+template<typename T, typename U> using TPromoteT = common_type_t<T, U>;
+template<typename T, typename U>
+struct TScalarPromote
+{
+  template<typename X> struct identity { using type = X; };
+  using type = typename conditional_t<is_integral<T>::value && is_floating_point<U>::value,
+    common_type<T, U>, identity<T>>::type;
+};
+template<typename T, typename U> using TScalarPromoteT = typename TScalarPromote<T, U>::type;
+
+// Тип накопителя в скалярных произведениях и свёртках:
+// элементы хранятся компактно, а суммируются в более широком типе
+template<typename T> struct TAccumulator { using type = T; };
+template<> struct TAccumulator<float> { using type = double; };
+template<typename T> using TAccumulatorT = typename TAccumulator<T>::type;
+
+// модуль для любого типа с < и унарным минусом
+template<typename T>
+T absValue(const T& x)
+{
+  return x < T() ? (T)-x : x;
+}
+
+// Способ суммирования в скалярных произведениях и свёртках:
+// Serial   - последовательно в одну переменную (как раньше);
+// Pairwise - попарно (дерево), погрешность O(log n), векторизуется;
+// Kahan    - с компенсацией ошибки округления
+enum class TSumMode { Serial, Pairwise, Kahan };
+
+struct TReduction
+{
+  // режим для всех операций; меняется до запуска вычислений
+  static inline TSumMode mode = TSumMode::Pairwise;
+  // воспроизводимость: дерево суммирования зависит только от n, но не от
+  // числа потоков (отрезки фиксированной длины PARALLEL_CHUNK сводятся
+  // тем же способом); false - по отрезку на поток, быстрее, но биты
+  // результата зависят от TParallel::threads
+  static inline bool deterministic = true;
+  // размер листа попарного дерева
+  static constexpr size_t PAIRWISE_BLOCK = 128;
+  // длина отрезка параллельного суммирования (кратна PAIRWISE_BLOCK)
+  static constexpr size_t PARALLEL_CHUNK = 32768;
+
+  // сумма слагаемых term(0) ... term(n - 1); term вызывается из разных потоков
+  template<typename Acc, typename F>
+  static Acc sum(size_t n, F term, TSumMode m = mode)
+  {
+    if (m == TSumMode::Serial || n <= PARALLEL_CHUNK)
+      return sumRange<Acc>(0, n, term, m);
+    size_t chunks = deterministic ? (n + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK
+                                  : std::min(TParallel::concurrency(), (n + PARALLEL_CHUNK - 1) / PARALLEL_CHUNK);
+    size_t len = (n + chunks - 1) / chunks;
+    if (deterministic)
+      len = PARALLEL_CHUNK;
+    std::vector<Acc> part(chunks);
+    TParallel::forEach(chunks, [&](size_t c) {
+      part[c] = sumRange<Acc>(c * len, std::min(n, (c + 1) * len), term, m);
+    });
+    return sumRange<Acc>(0, chunks, [&part](size_t c) { return part[c]; }, m);
+  }
+  template<typename Acc, typename F>
+  static Acc sumRange(size_t first, size_t last, F term, TSumMode m)
+  {
+    switch (m)
+    {
+    case TSumMode::Pairwise:
+      return pairwise<Acc>(first, last, term);
+    case TSumMode::Kahan:
+      return kahan<Acc>(first, last, term);
+    default:
+      return serial<Acc>(first, last, term);
+    }
+  }
+
+  template<typename Acc, typename F>
+  static Acc serial(size_t first, size_t last, F term)
+  {
+    Acc res = Acc();
+    for (size_t i = first; i < last; i++)
+      res = res + term(i);
+    return res;
+  }
+  // лист - восемь независимых частичных сумм в фиксированном порядке, иначе
+  // деление пополам по границе, кратной PAIRWISE_BLOCK; форма дерева зависит
+  // только от n, а не от ширины SIMD (без -ffast-math порядок не меняется)
+  template<typename Acc, typename F>
+  static Acc pairwise(size_t first, size_t last, F term)
+  {
+    size_t n = last - first;
+    if (n <= PAIRWISE_BLOCK)
+    {
+      Acc s[8] = {};
+      size_t i = first;
+      for (; i + 8 <= last; i += 8)
+        for (size_t k = 0; k < 8; k++)
+          s[k] = s[k] + term(i + k);
+      for (size_t k = 0; i < last; i++, k++)
+        s[k] = s[k] + term(i);
+      return ((s[0] + s[1]) + (s[2] + s[3])) + ((s[4] + s[5]) + (s[6] + s[7]));
+    }
+    size_t half = (n / PAIRWISE_BLOCK + 1) / 2 * PAIRWISE_BLOCK;
+    return pairwise<Acc>(first, first + half, term) + pairwise<Acc>(first + half, last, term);
+  }
+  template<typename Acc, typename F>
+  static Acc kahan(size_t first, size_t last, F term)
+  {
+    Acc res = Acc(), c = Acc();
+    for (size_t i = first; i < last; i++)
+    {
+      Acc y = term(i) - c;
+      Acc t = res + y;
+      c = (t - res) - y;
+      res = t;
+    }
+    return res;
+  }
+};
+
+// Ядра над непрерывными массивами; специализируются для компактных типов (tcompact.h)
+// скалярное произведение с накоплением в Acc
+template<typename Acc, typename A, typename B>
+struct TDotKernel
+{
+  static Acc run(const A* a, const B* b, size_t n)
+  {
+    return TReduction::sum<Acc>(n, [a, b](size_t i) { return (Acc)a[i] * (Acc)b[i]; });
+  }
+};
+// поэлементное приведение типа
+template<typename To, typename From>
+struct TConvertKernel
+{
+  static void run(const From* src, To* dst, size_t n)
+  {
+    for (size_t i = 0; i < n; i++)
+      dst[i] = (To)src[i];
+  }
+};
+// поэлементное сравнение: блоки проверяются без ветвлений (векторизуется),
+// выход - после первого блока с различием; большие массивы - параллельно
+struct TCompare
+{
+  static constexpr size_t BLOCK = 256;
+
+  // ok(first, last) для блоков [0, n) длиной не больше block, пока все ok
+  template<typename F>
+  static bool allBlocks(size_t n, size_t block, F ok)
+  {
+    atomic<bool> res(true);
+    TParallel::forRange(n, TParallel::GRAIN, [&](size_t first, size_t last) {
+      for (size_t i = first; i < last && res.load(memory_order_relaxed); i += block)
+        if (!ok(i, min(last, i + block)))
+          res.store(false, memory_order_relaxed);
+    });
+    return res.load();
+  }
+  // pred(a[i], b[i]) для всех i
+  template<typename A, typename B, typename P>
+  static bool all(const A* a, const B* b, size_t n, P pred)
+  {
+    return allBlocks(n, BLOCK, [a, b, &pred](size_t first, size_t last) {
+      bool good = true;
+      for (size_t i = first; i < last; i++)
+        good &= (bool)pred(a[i], b[i]);
+      return good;
+    });
+  }
+  // a[i] == b[i]; целые и перечисления сравниваются memcmp, остальные - через ==
+  // (у THalf и TBFloat16 тоже однозначное представление, но -0 == +0 и NaN != NaN)
+  template<typename T>
+  static bool equal(const T* a, const T* b, size_t n)
+  {
+    if constexpr (is_integral<T>::value || is_enum<T>::value)
+    {
+      if (a == b)
+        return true;
+      return allBlocks(n, BLOCK * 16, [a, b](size_t first, size_t last) {
+        return memcmp(a + first, b + first, (last - first) * sizeof(T)) == 0;
+      });
+    }
+    else
+      return all(a, b, n, [](const T& x, const T& y) { return x == y; });
+  }
+  // |a[i] - b[i]| <= atol + rtol * |b[i]| (как numpy.allclose): NaN не близок ничему,
+  // бесконечность близка только такой же бесконечности
+  template<typename A, typename B>
+  static bool close(TVectorView<const A> a, TVectorView<const B> b, double rtol, double atol)
+  {
+    using W = TAccumulatorT<TPromoteT<A, B>>;
+    // у целых допуски не округляются до целого: сравнение идёт в long double
+    using Tol = conditional_t<is_integral<W>::value, long double, W>;
+    if (a.size() != b.size())
+      return false;
+    auto pred = [r = (Tol)rtol, t = (Tol)atol](const A& x, const B& y) {
+      // без вычитания меньшего из большего беззнаковая разность переполнится
+      W u = (W)x, v = (W)y, d = u > v ? (W)(u - v) : (W)(v - u);
+      return u == v || ((Tol)d <= t + r * absValue((Tol)v) && d - d == W());
+    };
+    if (a.isContiguous() && b.isContiguous())
+      return all(a.data(), b.data(), a.size(), pred);
+    for (size_t i = 0; i < a.size(); i++)
+      if (!pred(a[i], b[i]))
+        return false;
+    return true;
+  }
+};
+
+// хеширование значений элементов, согласованное с ==: у вещественных -0 и +0
+// дают одни и те же байты; остальные типы (без байтов-заполнителей) хешируются
+// по представлению в памяти
+struct TContentHash
+{
+  static constexpr size_t BLOCK = 256;
+
+  // байты значения: у 80-битного long double остальные байты объекта - заполнитель
+  // с произвольным содержимым
+  template<typename T>
+  static constexpr size_t valueBytes()
+  {
+    if constexpr (is_floating_point<T>::value && numeric_limits<T>::digits == 64)
+      return 10;
+    else
+      return sizeof(T);
+  }
+
+  template<typename T>
+  static void update(THash64& h, TVectorView<const T> v)
+  {
+    static_assert(is_floating_point<T>::value || has_unique_object_representations<T>::value,
+      "hashing requires T without padding bytes");
+    if (!is_floating_point<T>::value && v.isContiguous())
+    {
+      h.update(v.data(), v.size() * sizeof(T));
+      return;
+    }
+    constexpr size_t VB = valueBytes<T>();
+    unsigned char buf[BLOCK * VB];
+    for (size_t i = 0; i < v.size(); i += BLOCK)
+    {
+      size_t len = min(BLOCK, v.size() - i);
+      for (size_t j = 0; j < len; j++)
+      {
+        T x = v[i + j];
+        if constexpr (is_floating_point<T>::value)
+          x = x == T() ? T() : x;
+        memcpy(buf + j * VB, &x, VB);
+      }
+      h.update(buf, len * VB);
+    }
+  }
+};
+
+// ключ кэша результатов по содержимому операндов (два хеша с разными затравками);
+// в флаги входит TReduction::mode - от него зависят биты результата
+template<typename T>
+TMemoKey makeMemoKey(TMemoOp op, uint32_t flags, TMatrixView<const T> a, const TMatrixView<const T>* b = nullptr)
+{
+  const uint64_t SEED = 0x9E3779B97F4A7C15ull;
+  flags |= (uint32_t)TReduction::mode << 16;
+  TMemoKey k{ op, flags, type_index(typeid(T)), { a.hash(), a.hash(SEED) }, { 0, 0 } };
+  if (b)
+  {
+    k.b[0] = b->hash();
+    k.b[1] = b->hash(SEED);
+  }
+  return k;
+}
+
+// Представление вектора -
+// невладеющая ссылка на элементы с шагом stride
+// (срез вектора, строка или столбец матрицы)
+template<typename T>
+class TVectorView
+{
+protected:
+  T* pMem;
+  size_t sz;
+  ptrdiff_t step;
+public:
+  using value_type = remove_const_t<T>;
+
+  TVectorView(T* p, size_t size, ptrdiff_t stride = 1) noexcept : pMem(p), sz(size), step(stride) {}
+  TVectorView(const TVectorView&) = default;
+  // TVectorView<T> -> TVectorView<const T>
+  template<typename U, enable_if_t<is_same<const U, T>::value && !is_same<U, T>::value, int> = 0>
+  TVectorView(const TVectorView<U>& v) noexcept : pMem(v.data()), sz(v.size()), step(v.stride()) {}
+  // весь вектор; константное представление можно получить и от временного объекта
+  // (и оно не отделяет общий буфер в режиме копирования при записи)
+  template<typename V, enable_if_t<is_same<remove_cv_t<remove_reference_t<V>>, TDynamicVector<value_type>>::value &&
+    (is_const<T>::value || (is_lvalue_reference<V>::value && !is_const<remove_reference_t<V>>::value)), int> = 0>
+  TVectorView(V&& v) : pMem(static_cast<conditional_t<is_const<T>::value,
+    const remove_reference_t<V>&, remove_reference_t<V>&>>(v).data()), sz(v.size()), step(1) {}
+
+  size_t size() const noexcept { return sz; }
+  ptrdiff_t stride() const noexcept { return step; }
+  T* data() const noexcept { return pMem; }
+  bool isContiguous() const noexcept { return step == 1; }
+
+  // индексация
+  T& operator[](size_t ind) const
+  {
+    return pMem[(ptrdiff_t)ind * step];
+  }
+  // индексация с контролем
+  T& at(size_t ind) const
+  {
+    if (ind >= sz)
+      throw out_of_range("bad index");
+    return (*this)[ind];
+  }
+  // подпредставление без копирования
+  TVectorView slice(size_t offset, size_t length, ptrdiff_t stride = 1) const
+  {
+    if (length == 0 || stride == 0 || offset >= sz)
+      throw out_of_range("bad slice");
+    ptrdiff_t last = (ptrdiff_t)offset + (ptrdiff_t)(length - 1) * stride;
+    if (last < 0 || last >= (ptrdiff_t)sz)
+      throw out_of_range("bad slice");
+    return TVectorView(pMem + (ptrdiff_t)offset * step, length, stride * step);
+  }
+
+  // копирование элементов (представления не должны перекрываться)
+  TVectorView& operator=(const TVectorView& v)
+  {
+    return assign(v);
+  }
+  TVectorView& operator=(TVectorView<const value_type> v)
+  {
+    return assign(v);
+  }
+  TVectorView& assign(TVectorView<const value_type> v)
+  {
+    if (sz != v.size())
+      throw out_of_range("different size");
+    if (isContiguous() && v.isContiguous())
+      std::copy(v.data(), v.data() + sz, pMem);
+    else
+      for (size_t i = 0; i < sz; i++)
+        (*this)[i] = v[i];
+    return *this;
+  }
+
+  // операции на месте
+  TVectorView& operator+=(TVectorView<const value_type> v)
+  {
+    if (sz != v.size())
+      throw out_of_range("different size");
+    if (isContiguous() && v.isContiguous())
+      for (size_t i = 0; i < sz; i++)
+        pMem[i] = pMem[i] + v.data()[i];
+    else
+      for (size_t i = 0; i < sz; i++)
+        (*this)[i] = (*this)[i] + v[i];
+    return *this;
+  }
+  TVectorView& operator-=(TVectorView<const value_type> v)
+  {
+    if (sz != v.size())
+      throw out_of_range("different size");
+    if (isContiguous() && v.isContiguous())
+      for (size_t i = 0; i < sz; i++)
+        pMem[i] = pMem[i] - v.data()[i];
+    else
+      for (size_t i = 0; i < sz; i++)
+        (*this)[i] = (*this)[i] - v[i];
+    return *this;
+  }
+  TVectorView& operator+=(const value_type& val)
+  {
+    return assignMapped(*this, [&val](const value_type& x) { return x + val; });
+  }
+  TVectorView& operator-=(const value_type& val)
+  {
+    return assignMapped(*this, [&val](const value_type& x) { return x - val; });
+  }
+  TVectorView& operator*=(const value_type& val)
+  {
+    return assignMapped(*this, [&val](const value_type& x) { return x * val; });
+  }
+  TVectorView& operator/=(const value_type& val)
+  {
+    return assignMapped(*this, [&val](const value_type& x) { return x / val; });
+  }
+  // this += alpha * v
+  TVectorView& addScaled(TVectorView<const value_type> v, const value_type& alpha)
+  {
+    if (sz != v.size())
+      throw out_of_range("different size");
+    if (isContiguous() && v.isContiguous())
+      for (size_t i = 0; i < sz; i++)
+        pMem[i] = pMem[i] + alpha * v.data()[i];
+    else
+      for (size_t i = 0; i < sz; i++)
+        (*this)[i] = (*this)[i] + alpha * v[i];
+    return *this;
+  }
+
+  // векторные операции
+  TDynamicVector<value_type> operator+(TVectorView<const value_type> v) const
+  {
+    TDynamicVector<value_type> res(*this);
+    res.view() += v;
+    return res;
+  }
+  TDynamicVector<value_type> operator-(TVectorView<const value_type> v) const
+  {
+    TDynamicVector<value_type> res(*this);
+    res.view() -= v;
+    return res;
+  }
+  value_type operator*(TVectorView<const value_type> v) const
+  {
+    return (value_type)dot<TAccumulatorT<value_type>>(v);
+  }
+  // скалярное произведение с накоплением в типе Acc
+  template<typename Acc, typename U>
+  Acc dot(TVectorView<U> v) const
+  {
+    size_t min_sz = sz < v.size() ? sz : v.size();
+    if (isContiguous() && v.isContiguous())
+      return TDotKernel<Acc, value_type, remove_const_t<U>>::run(pMem, v.data(), min_sz);
+    return TReduction::sum<Acc>(min_sz, [this, &v](size_t i) { return (Acc)(*this)[i] * (Acc)v[i]; });
+  }
+
+  // поэлементные преобразования; длинные векторы обрабатываются параллельно,
+  // поэтому f вызывается из разных потоков
+  template<typename F>
+  TVectorView& apply(F f)
+  {
+    TParallel::forRange(sz, TParallel::GRAIN, [&](size_t first, size_t last) {
+      slice(first, last - first).assignMapped(slice(first, last - first), f);
+    });
+    return *this;
+  }
+  // this[i] = f(this[i], v[i])
+  template<typename U, typename F>
+  TVectorView& apply(TVectorView<U> v, F f)
+  {
+    if (sz != v.size())
+      throw out_of_range("different size");
+    TParallel::forRange(sz, TParallel::GRAIN, [&](size_t first, size_t last) {
+      TVectorView x = slice(first, last - first);
+      x.assignZipped(x, v.slice(first, last - first), f);
+    });
+    return *this;
+  }
+  template<typename F>
+  TDynamicVector<decay_t<invoke_result_t<F&, const value_type&>>> map(F f) const
+  {
+    using R = decay_t<invoke_result_t<F&, const value_type&>>;
+    TDynamicVector<R> res(sz);
+    TVectorView<R> r = res.view();
+    TParallel::forRange(sz, TParallel::GRAIN, [&](size_t first, size_t last) {
+      r.slice(first, last - first).assignMapped(slice(first, last - first), f);
+    });
+    return res;
+  }
+  // последовательные ядра: this[i] = f(a[i]) и this[i] = f(a[i], b[i])
+  template<typename U, typename F>
+  TVectorView& assignMapped(TVectorView<U> a, F f)
+  {
+    if (sz != a.size())
+      throw out_of_range("different size");
+    if (isContiguous() && a.isContiguous())
+    {
+      T* p = pMem;
+      U* x = a.data();
+      for (size_t i = 0; i < sz; i++)
+        p[i] = f(x[i]);
+    }
+    else
+      for (size_t i = 0; i < sz; i++)
+        (*this)[i] = f(a[i]);
+    return *this;
+  }
+  template<typename U, typename V, typename F>
+  TVectorView& assignZipped(TVectorView<U> a, TVectorView<V> b, F f)
+  {
+    if (sz != a.size() || sz != b.size())
+      throw out_of_range("different size");
+    if (isContiguous() && a.isContiguous() && b.isContiguous())
+    {
+      T* p = pMem;
+      U* x = a.data();
+      V* y = b.data();
+      for (size_t i = 0; i < sz; i++)
+        p[i] = f(x[i], y[i]);
+    }
+    else
+      for (size_t i = 0; i < sz; i++)
+        (*this)[i] = f(a[i], b[i]);
+    return *this;
+  }
+
+  // поэлементное (адамарово) умножение и деление
+  TVectorView& cwiseMultiply(TVectorView<const value_type> v)
+  {
+    return apply(v, [](const value_type& x, const value_type& y) { return x * y; });
+  }
+  TVectorView& cwiseDivide(TVectorView<const value_type> v)
+  {
+    return apply(v, [](const value_type& x, const value_type& y) { return x / y; });
+  }
+  TDynamicVector<value_type> cwiseProduct(TVectorView<const value_type> v) const
+  {
+    TDynamicVector<value_type> res(*this);
+    res.view().cwiseMultiply(v);
+    return res;
+  }
+  TDynamicVector<value_type> cwiseQuotient(TVectorView<const value_type> v) const
+  {
+    TDynamicVector<value_type> res(*this);
+    res.view().cwiseDivide(v);
+    return res;
+  }
+
+  // свёртки и нормы (один проход; длинные векторы - параллельно)
+  value_type sum() const
+  {
+    return (value_type)sumOf([](const value_type& x) { return x; });
+  }
+  value_type norm1() const
+  {
+    return (value_type)sumOf([](const value_type& x) { return absValue(x); });
+  }
+  auto norm2() const
+  {
+    using Acc = TAccumulatorT<value_type>;
+    return std::sqrt(sumOf([](const value_type& x) { return (Acc)x * (Acc)x; }));
+  }
+  value_type normInf() const
+  {
+    return absValue((*this)[argBy([](const value_type& x, const value_type& y) { return absValue(x) < absValue(y); })]);
+  }
+  value_type min() const
+  {
+    return (*this)[argmin()];
+  }
+  value_type max() const
+  {
+    return (*this)[argmax()];
+  }
+  // индекс первого наименьшего / наибольшего элемента
+  size_t argmin() const
+  {
+    return argBy([](const value_type& x, const value_type& y) { return y < x; });
+  }
+  size_t argmax() const
+  {
+    return argBy([](const value_type& x, const value_type& y) { return x < y; });
+  }
+
+private:
+  // сумма f(x) по всем элементам в типе накопителя
+  template<typename F>
+  auto sumOf(F f) const
+  {
+    using Acc = TAccumulatorT<value_type>;
+    using R = common_type_t<Acc, decltype(f(declval<value_type>()))>;
+    if (isContiguous())
+    {
+      const value_type* p = pMem;
+      return TReduction::sum<R>(sz, [p, &f](size_t i) { return (R)f(p[i]); });
+    }
+    return TReduction::sum<R>(sz, [this, &f](size_t i) { return (R)f((*this)[i]); });
+  }
+  // индекс первого элемента x, для которого less(x, y) ложно для всех остальных y
+  template<typename Less>
+  size_t argBy(Less less) const
+  {
+    if (sz == 0)
+      throw out_of_range("empty view");
+    auto scan = [this, &less](size_t first, size_t last) {
+      size_t best = first;
+      if (isContiguous())
+      {
+        for (size_t i = first + 1; i < last; i++)
+          if (less(pMem[best], pMem[i]))
+            best = i;
+      }
+      else
+        for (size_t i = first + 1; i < last; i++)
+          if (less((*this)[best], (*this)[i]))
+            best = i;
+      return best;
+    };
+    if (sz <= TReduction::PARALLEL_CHUNK)
+      return scan(0, sz);
+    size_t chunks = (sz + TReduction::PARALLEL_CHUNK - 1) / TReduction::PARALLEL_CHUNK;
+    std::vector<size_t> part(chunks);
+    TParallel::forEach(chunks, [&](size_t c) {
+      part[c] = scan(c * TReduction::PARALLEL_CHUNK, std::min(sz, (c + 1) * TReduction::PARALLEL_CHUNK));
+    });
+    size_t best = part[0];
+    for (size_t c = 1; c < chunks; c++)
+      if (less((*this)[best], (*this)[part[c]]))
+        best = part[c];
+    return best;
+  }
+};
+
+
+// Представление матрицы -
+// невладеющая ссылка на прямоугольный блок с шагами по строкам и столбцам
+template<typename T>
+class TMatrixView
+{
+protected:
+  T* pMem;
+  size_t nRows, nCols;
+  ptrdiff_t rowStep, colStep;
+public:
+  using value_type = remove_const_t<T>;
+  // минимальный объём работы (умножений) на один поток
+  static constexpr size_t PARALLEL_WORK = 1 << 16;
+
+  TMatrixView(T* p, size_t rows, size_t cols, ptrdiff_t rowStride, ptrdiff_t colStride = 1) noexcept
+    : pMem(p), nRows(rows), nCols(cols), rowStep(rowStride), colStep(colStride) {}
+  TMatrixView(const TMatrixView&) = default;
+  // TMatrixView<T> -> TMatrixView<const T>
+  template<typename U, enable_if_t<is_same<const U, T>::value && !is_same<U, T>::value, int> = 0>
+  TMatrixView(const TMatrixView<U>& m) noexcept
+    : pMem(m.data()), nRows(m.rows()), nCols(m.cols()), rowStep(m.rowStride()), colStep(m.colStride()) {}
+  // вся матрица (шаги определяются её порядком хранения)
+  template<typename M, enable_if_t<is_same<remove_cv_t<remove_reference_t<M>>, TDynamicMatrix<value_type>>::value &&
+    (is_const<T>::value || (is_lvalue_reference<M>::value && !is_const<remove_reference_t<M>>::value)), int> = 0>
+  TMatrixView(M&& m) : TMatrixView(TMatrixView<T>(static_cast<conditional_t<is_const<T>::value,
+    const remove_reference_t<M>&, remove_reference_t<M>&>>(m).view())) {}
+
+  size_t rows() const noexcept { return nRows; }
+  size_t cols() const noexcept { return nCols; }
+  ptrdiff_t rowStride() const noexcept { return rowStep; }
+  ptrdiff_t colStride() const noexcept { return colStep; }
+  T* data() const noexcept { return pMem; }
+  // элементы лежат подряд без пропусков (по строкам или по столбцам)
+  bool isContiguous() const noexcept
+  {
+    return (colStep == 1 && rowStep == (ptrdiff_t)nCols) || (rowStep == 1 && colStep == (ptrdiff_t)nRows);
+  }
+  // какое направление лежит в памяти подряд
+  TMatrixLayout layout() const noexcept
+  {
+    return (colStep != 1 && rowStep == 1) ? TMatrixLayout::ColMajor : TMatrixLayout::RowMajor;
+  }
+
+  // хеш содержимого (xxHash64) по строкам: не зависит от шагов и порядка хранения,
+  // равные матрицы имеют равные хеши
+  uint64_t hash(uint64_t seed = 0) const
+  {
+    THash64 h(seed);
+    h.updateValue((uint64_t)nRows).updateValue((uint64_t)nCols);
+    if (colStep == 1 && rowStep == (ptrdiff_t)nCols)
+      TContentHash::update<value_type>(h, flat());
+    else
+      for (size_t i = 0; i < nRows; i++)
+        TContentHash::update<value_type>(h, (*this)[i]);
+    return h.digest();
+  }
+
+  // индексация
+  T& operator()(size_t i, size_t j) const
+  {
+    return pMem[(ptrdiff_t)i * rowStep + (ptrdiff_t)j * colStep];
+  }
+  TVectorView<T> operator[](size_t ind) const
+  {
+    return TVectorView<T>(pMem + (ptrdiff_t)ind * rowStep, nCols, colStep);
+  }
+  // индексация с контролем
+  T& at(size_t i, size_t j) const
+  {
+    if (i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    return (*this)(i, j);
+  }
+
+  // подпредставления без копирования
+  TVectorView<T> row(size_t i) const
+  {
+    if (i >= nRows)
+      throw out_of_range("bad index");
+    return (*this)[i];
+  }
+  TVectorView<T> col(size_t j) const
+  {
+    if (j >= nCols)
+      throw out_of_range("bad index");
+    return TVectorView<T>(pMem + (ptrdiff_t)j * colStep, nRows, rowStep);
+  }
+  TMatrixView block(size_t r0, size_t c0, size_t rows, size_t cols) const
+  {
+    if (rows == 0 || cols == 0 || r0 + rows > nRows || c0 + cols > nCols)
+      throw out_of_range("bad block");
+    return TMatrixView(&(*this)(r0, c0), rows, cols, rowStep, colStep);
+  }
+  TMatrixView rowRange(size_t r0, size_t rows) const
+  {
+    return block(r0, 0, rows, nCols);
+  }
+  TMatrixView transpose() const noexcept
+  {
+    return TMatrixView(pMem, nCols, nRows, colStep, rowStep);
+  }
+  // непрерывный блок как один вектор
+  TVectorView<T> flat() const
+  {
+    assert(isContiguous() && "TMatrixView::flat requires contiguous view");
+    return TVectorView<T>(pMem, nRows * nCols);
+  }
+
+  // копирование элементов (представления не должны перекрываться)
+  TMatrixView& operator=(const TMatrixView& m)
+  {
+    return assign(m);
+  }
+  TMatrixView& operator=(TMatrixView<const value_type> m)
+  {
+    return assign(m);
+  }
+  TMatrixView& assign(TMatrixView<const value_type> m)
+  {
+    forEachLine([](TVectorView<T> x, TVectorView<const value_type> y) { x.assign(y); }, m);
+    return *this;
+  }
+
+  // операции на месте
+  TMatrixView& operator+=(TMatrixView<const value_type> m)
+  {
+    forEachLine([](TVectorView<T> x, TVectorView<const value_type> y) { x += y; }, m);
+    return *this;
+  }
+  TMatrixView& operator-=(TMatrixView<const value_type> m)
+  {
+    forEachLine([](TVectorView<T> x, TVectorView<const value_type> y) { x -= y; }, m);
+    return *this;
+  }
+  TMatrixView& operator+=(const value_type& val)
+  {
+    forEachLine([&val](TVectorView<T> x) { x += val; });
+    return *this;
+  }
+  TMatrixView& operator-=(const value_type& val)
+  {
+    forEachLine([&val](TVectorView<T> x) { x -= val; });
+    return *this;
+  }
+  TMatrixView& operator*=(const value_type& val)
+  {
+    forEachLine([&val](TVectorView<T> x) { x *= val; });
+    return *this;
+  }
+  TMatrixView& operator/=(const value_type& val)
+  {
+    forEachLine([&val](TVectorView<T> x) { x /= val; });
+    return *this;
+  }
+  // this += a * b; блок-результат не должен перекрываться с сомножителями
+  TMatrixView& addProduct(TMatrixView<const value_type> a, TMatrixView<const value_type> b)
+  {
+    if (a.cols() != b.rows() || a.rows() != nRows || b.cols() != nCols)
+      throw out_of_range("different size");
+    // по столбцам: C^T += B^T * A^T, где C^T уже хранится по строкам
+    if (layout() == TMatrixLayout::ColMajor)
+    {
+      transpose().addProduct(b.transpose(), a.transpose());
+      return *this;
+    }
+    using Acc = TAccumulatorT<value_type>;
+    // строки результата делятся между потоками; каждый элемент считается
+    // одним потоком в одном и том же порядке, поэтому число потоков
+    // не влияет на результат
+    size_t grain = std::max<size_t>(1, PARALLEL_WORK / (nCols * a.cols() + 1));
+    if (TReduction::mode != TSumMode::Serial)
+    {
+      // каждый элемент - скалярное произведение строки A на строку B^T
+      // выбранным способом суммирования
+      auto rows = [&](TMatrixView<const value_type> bt) {
+        TParallel::forRange(nRows, grain, [&](size_t first, size_t last) {
+          for (size_t i = first; i < last; i++)
+          {
+            TVectorView<T> c = (*this)[i];
+            TVectorView<const value_type> ai = a[i];
+            for (size_t j = 0; j < nCols; j++)
+              c[j] = c[j] + (value_type)ai.template dot<Acc>(bt[j]);
+          }
+        });
+      };
+      // столбцы B, лежащие в памяти подряд, берутся как есть, иначе B^T копируется
+      if (b.rowStride() == 1)
+        rows(b.transpose());
+      else
+      {
+        TDynamicMatrix<value_type> bt(b.transpose());
+        rows(bt);
+      }
+    }
+    else if constexpr (is_same<Acc, value_type>::value)
+      TParallel::forRange(nRows, grain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+        {
+          TVectorView<T> c = (*this)[i];
+          for (size_t k = 0; k < a.cols(); k++)
+            c.addScaled(b[k], a(i, k));
+        }
+      });
+    else
+      TParallel::forRange(nRows, grain, [&](size_t first, size_t last) {
+        // строка результата копится в Acc и округляется один раз
+        TDynamicVector<Acc> acc(nCols);
+        for (size_t i = first; i < last; i++)
+        {
+          TVectorView<T> c = (*this)[i];
+          for (size_t j = 0; j < nCols; j++)
+            acc[j] = (Acc)c[j];
+          for (size_t k = 0; k < a.cols(); k++)
+          {
+            const Acc aik = (Acc)a(i, k);
+            TVectorView<const value_type> bk = b[k];
+            for (size_t j = 0; j < nCols; j++)
+              acc[j] = acc[j] + aik * (Acc)bk[j];
+          }
+          for (size_t j = 0; j < nCols; j++)
+            c[j] = (value_type)acc[j];
+        }
+      });
+    return *this;
+  }
+
+  // матрично-векторные операции
+  TDynamicVector<value_type> operator*(TVectorView<const value_type> v) const
+  {
+    if (v.size() != nCols)
+      throw out_of_range("bad size");
+    TDynamicVector<value_type> res(nRows);
+    TVectorView<value_type> r = res.view();
+    size_t grain = std::max<size_t>(1, PARALLEL_WORK / nCols);
+    if (layout() == TMatrixLayout::ColMajor && is_same<TAccumulatorT<value_type>, value_type>::value)
+      TParallel::forRange(nRows, grain, [&](size_t first, size_t last) {
+        for (size_t j = 0; j < nCols; j++)
+          r.slice(first, last - first).addScaled(col(j).slice(first, last - first), v[j]);
+      });
+    else
+      TParallel::forRange(nRows, grain, [&](size_t first, size_t last) {
+        for (size_t i = first; i < last; i++)
+          r[i] = (*this)[i] * v;
+      });
+    return res;
+  }
+
+  // матрично-матричные операции
+  TDynamicMatrix<value_type> operator+(TMatrixView<const value_type> m) const
+  {
+    TDynamicMatrix<value_type> res(*this, layout());
+    res.view() += m;
+    return res;
+  }
+  TDynamicMatrix<value_type> operator-(TMatrixView<const value_type> m) const
+  {
+    TDynamicMatrix<value_type> res(*this, layout());
+    res.view() -= m;
+    return res;
+  }
+  // при включённом TMemoCache результат запоминается по содержимому операндов
+  TDynamicMatrix<value_type> operator*(TMatrixView<const value_type> m) const
+  {
+    if (nCols != m.rows())
+      throw out_of_range("different size");
+    if (!TMemoCache::enabled)
+      return multiply(m);
+    return *TMemoCache::instance().getOrCompute<TDynamicMatrix<value_type>>(
+      makeMemoKey<value_type>(TMemoOp::Multiply, (uint32_t)layout(), *this, &m),
+      nRows * m.cols() * sizeof(value_type), [&] { return multiply(m); });
+  }
+  // произведение в обход TMemoCache (для промежуточных результатов)
+  TDynamicMatrix<value_type> multiply(TMatrixView<const value_type> m) const
+  {
+    if (nCols != m.rows())
+      throw out_of_range("different size");
+    TDynamicMatrix<value_type> res(nRows, m.cols(), layout());
+    res.view().addProduct(*this, m);
+    return res;
+  }
+
+  // поэлементные преобразования (f вызывается из разных потоков)
+  template<typename F>
+  TMatrixView& apply(F f)
+  {
+    forEachLine([&f](TVectorView<T> x) { x.assignMapped(x, f); });
+    return *this;
+  }
+  // this(i, j) = f(this(i, j), m(i, j))
+  template<typename U, typename F>
+  TMatrixView& apply(TMatrixView<U> m, F f)
+  {
+    forEachLine([&f](TVectorView<T> x, TVectorView<U> y) { x.assignZipped(x, y, f); }, m);
+    return *this;
+  }
+  template<typename F>
+  TDynamicMatrix<decay_t<invoke_result_t<F&, const value_type&>>> map(F f) const
+  {
+    using R = decay_t<invoke_result_t<F&, const value_type&>>;
+    TDynamicMatrix<R> res(nRows, nCols, layout());
+    res.view().assignMapped(*this, f);
+    return res;
+  }
+  template<typename U, typename F>
+  TMatrixView& assignMapped(TMatrixView<U> a, F f)
+  {
+    forEachLine([&f](TVectorView<T> r, TVectorView<U> x) { r.assignMapped(x, f); }, a);
+    return *this;
+  }
+  template<typename U, typename V, typename F>
+  TMatrixView& assignZipped(TMatrixView<U> a, TMatrixView<V> b, F f)
+  {
+    forEachLine([&f](TVectorView<T> r, TVectorView<U> x, TVectorView<V> y) { r.assignZipped(x, y, f); }, a, b);
+    return *this;
+  }
+
+  // поэлементное (адамарово) умножение и деление
+  TMatrixView& cwiseMultiply(TMatrixView<const value_type> m)
+  {
+    return apply(m, [](const value_type& x, const value_type& y) { return x * y; });
+  }
+  TMatrixView& cwiseDivide(TMatrixView<const value_type> m)
+  {
+    return apply(m, [](const value_type& x, const value_type& y) { return x / y; });
+  }
+  TDynamicMatrix<value_type> cwiseProduct(TMatrixView<const value_type> m) const
+  {
+    TDynamicMatrix<value_type> res(*this, layout());
+    res.view().cwiseMultiply(m);
+    return res;
+  }
+  TDynamicMatrix<value_type> cwiseQuotient(TMatrixView<const value_type> m) const
+  {
+    TDynamicMatrix<value_type> res(*this, layout());
+    res.view().cwiseDivide(m);
+    return res;
+  }
+
+  // свёртки и нормы
+  value_type sum() const
+  {
+    using Acc = TAccumulatorT<value_type>;
+    if (isContiguous())
+      return flat().sum();
+    // суммы строк не округляются до value_type
+    return (value_type)TReduction::sum<Acc>(nRows, [this](size_t i) {
+      TVectorView<T> r = (*this)[i];
+      return TReduction::sum<Acc>(nCols, [&r](size_t j) { return (Acc)r[j]; });
+    });
+  }
+  value_type trace() const
+  {
+    using Acc = TAccumulatorT<value_type>;
+    size_t n = nRows < nCols ? nRows : nCols;
+    return (value_type)TReduction::sum<Acc>(n, [this](size_t i) { return (Acc)(*this)(i, i); });
+  }
+  auto normFrobenius() const
+  {
+    using Acc = TAccumulatorT<value_type>;
+    if (isContiguous())
+      return flat().norm2();
+    Acc s = TReduction::sum<Acc>(nRows, [this](size_t i) {
+      TVectorView<T> r = (*this)[i];
+      return TReduction::sum<Acc>(nCols, [&r](size_t j) { return (Acc)r[j] * (Acc)r[j]; });
+    });
+    return std::sqrt(s);
+  }
+  // максимальная сумма модулей по столбцам
+  value_type norm1() const
+  {
+    return absSums(transpose()).max();
+  }
+  // максимальная сумма модулей по строкам
+  value_type normInf() const
+  {
+    return absSums(*this).max();
+  }
+  value_type min() const
+  {
+    pair<size_t, size_t> p = argmin();
+    return (*this)(p.first, p.second);
+  }
+  value_type max() const
+  {
+    pair<size_t, size_t> p = argmax();
+    return (*this)(p.first, p.second);
+  }
+  // позиция первого (в порядке хранения) наименьшего / наибольшего элемента
+  pair<size_t, size_t> argmin() const
+  {
+    return argBy(false);
+  }
+  pair<size_t, size_t> argmax() const
+  {
+    return argBy(true);
+  }
+  // суммы строк / столбцов
+  TDynamicVector<value_type> rowSums() const
+  {
+    TDynamicVector<value_type> res(nRows);
+    if (layout() == TMatrixLayout::ColMajor)
+      for (size_t j = 0; j < nCols; j++)
+        res.view() += col(j);
+    else
+      for (size_t i = 0; i < nRows; i++)
+        res[i] = (*this)[i].sum();
+    return res;
+  }
+  TDynamicVector<value_type> colSums() const
+  {
+    return transpose().rowSums();
+  }
+
+private:
+  // суммы модулей по строкам m (через TReduction, в том числе для строк с шагом)
+  static TDynamicVector<value_type> absSums(TMatrixView<const value_type> m)
+  {
+    TDynamicVector<value_type> res(m.rows());
+    for (size_t i = 0; i < m.rows(); i++)
+      res[i] = m[i].norm1();
+    return res;
+  }
+  pair<size_t, size_t> argBy(bool greatest) const
+  {
+    size_t bi = 0, bj = 0;
+    if (isContiguous())
+    {
+      TVectorView<const value_type> f = flat();
+      size_t k = greatest ? f.argmax() : f.argmin();
+      if (layout() == TMatrixLayout::ColMajor)
+        return make_pair(k % nRows, k / nRows);
+      return make_pair(k / nCols, k % nCols);
+    }
+    for (size_t i = 0; i < nRows; i++)
+    {
+      TVectorView<const value_type> r = (*this)[i];
+      size_t j = greatest ? r.argmax() : r.argmin();
+      if (i == 0 || (greatest ? (*this)(bi, bj) < r[j] : r[j] < (*this)(bi, bj)))
+      {
+        bi = i;
+        bj = j;
+      }
+    }
+    return make_pair(bi, bj);
+  }
+  // поэлементная операция над представлениями одной формы: f получает соответствующие
+  // отрезки-векторы. Если все лежат подряд в одном порядке - отрезки плоского массива,
+  // иначе строки или столбцы (смотря что у *this лежит в памяти подряд); отрезки
+  // обрабатываются параллельно
+  template<typename F, typename... V>
+  void forEachLine(F f, TMatrixView<V>... ms) const
+  {
+    if (((nRows != ms.rows() || nCols != ms.cols()) || ...))
+      throw out_of_range("different size");
+    if (isContiguous() && ((ms.isContiguous() && ms.layout() == layout()) && ...))
+      TParallel::forRange(nRows * nCols, TParallel::GRAIN, [&](size_t first, size_t last) {
+        f(TVectorView<T>(pMem + first, last - first), TVectorView<V>(ms.data() + first, last - first)...);
+      });
+    else
+    {
+      bool byCols = layout() == TMatrixLayout::ColMajor;
+      size_t lines = byCols ? nCols : nRows, len = byCols ? nRows : nCols;
+      TParallel::forRange(lines, std::max<size_t>(1, TParallel::GRAIN / len), [&](size_t first, size_t last) {
+        for (size_t k = first; k < last; k++)
+          f(lineOf(*this, byCols, k), lineOf(ms, byCols, k)...);
+      });
+    }
+  }
+  template<typename V>
+  static TVectorView<V> lineOf(const TMatrixView<V>& m, bool byCols, size_t k)
+  {
+    return byCols ? m.col(k) : m[k];
+  }
+};
+
+
+// Динамический вектор -
 // шаблонный вектор на динамической памяти
 template<typename T>
 class TDynamicVector
@@ -25,49 +1141,219 @@ class TDynamicVector
 protected:
   size_t sz;
   T* pMem;
+  // счётчик владельцев общего буфера в режиме копирования при записи; иначе nullptr
+  atomic<size_t>* refs = nullptr;
+  // наружу выдана изменяемая ссылка или представление элементов: буфер больше
+  // не делится, копии получают свои элементы
+  bool unshareable = false;
+
+  // тривиальные элементы размещаются через TMemory (с учётом политики NUMA)
+  // и заполняются по отрезкам; остальные - через new[]
+  static constexpr bool TRIVIAL = is_trivial<T>::value;
+
+  // f(first, last) по отрезкам массива из n элементов: для больших массивов - параллельно
+  template<typename F>
+  static void touch(size_t n, F f)
+  {
+    if (TMemory::spread(n * sizeof(T)))
+      TParallel::forRange(n, TParallel::GRAIN, f);
+    else
+      f((size_t)0, n);
+  }
+  // память под n элементов без инициализации (для нетривиальных T - по умолчанию)
+  static T* allocate(size_t n)
+  {
+    if constexpr (TRIVIAL)
+      return static_cast<T*>(TMemory::allocate(n * sizeof(T)));
+    else
+      return new T[n];
+  }
+  // память под n элементов, заполненных T()
+  static T* allocateZeroed(size_t n)
+  {
+    if constexpr (TRIVIAL)
+    {
+      T* p = allocate(n);
+      touch(n, [p](size_t first, size_t last) { std::fill(p + first, p + last, T()); });
+      return p;
+    }
+    else
+      return new T[n]();
+  }
+  // dst[0, n) = src[0, n): тривиально копируемые элементы - memcpy по отрезкам,
+  // очень большие массивы - потоковой записью
+  static void copyElements(T* dst, const T* src, size_t n)
+  {
+    if constexpr (is_trivially_copyable<T>::value)
+    {
+      bool stream = n * sizeof(T) >= TMemory::STREAM;
+      touch(n, [dst, src, stream](size_t first, size_t last) {
+        TMemory::copy(dst + first, src + first, (last - first) * sizeof(T), stream);
+      });
+    }
+    else
+      touch(n, [dst, src](size_t first, size_t last) { std::copy(src + first, src + last, dst + first); });
+  }
+  // копия n элементов src
+  static T* allocateCopy(const T* src, size_t n)
+  {
+    T* p = allocate(n);
+    copyElements(p, src, n);
+    return p;
+  }
+  static void release(T* p, size_t n) noexcept
+  {
+    if constexpr (TRIVIAL)
+    {
+      if (p)
+        TMemory::release(p, n * sizeof(T));
+    }
+    else
+      delete[] p;
+  }
+
+  void initRefs()
+  {
+    if (TMemory::copyOnWrite)
+      refs = new atomic<size_t>(1);
+  }
+  bool isShared() const noexcept
+  {
+    return refs && refs->load(memory_order_acquire) != 1;
+  }
+  // отказ от буфера; последний владелец его освобождает
+  void drop() noexcept
+  {
+    if (!refs)
+      release(pMem, sz);
+    else if (refs->fetch_sub(1, memory_order_acq_rel) == 1)
+    {
+      release(pMem, sz);
+      delete refs;
+    }
+    refs = nullptr;
+  }
+  // перед изменением элементов: общий буфер заменяется своей копией
+  void detach()
+  {
+    if (!isShared())
+      return;
+    atomic<size_t>* own = new atomic<size_t>(1);
+    T* p;
+    try
+    {
+      p = allocateCopy(pMem, sz);
+    }
+    catch (...)
+    {
+      delete own;
+      throw;
+    }
+    drop();
+    pMem = p;
+    refs = own;
+  }
+  // перед выдачей изменяемой ссылки или представления наружу
+  void leak()
+  {
+    detach();
+    unshareable = true;
+  }
+  // изменяемое представление для собственных операций (буфер остаётся общим)
+  TVectorView<T> ownView()
+  {
+    detach();
+    return TVectorView<T>(pMem, sz);
+  }
+  // можно ли делить буфер v вместо копирования элементов
+  static bool canShare(const TDynamicVector& v) noexcept
+  {
+    return v.refs && !v.unshareable;
+  }
 public:
   TDynamicVector(size_t size = 1) : sz(size)
   {
     if (sz == 0)
       throw out_of_range("Vector size should be greater than zero");
-    pMem = new T[sz]();// {}; // У типа T д.б. констуктор по умолчанию
+    if (sz > MAX_VECTOR_SIZE)
+      throw out_of_range("Vector size should be not greater than MAX_VECTOR_SIZE");
+    pMem = allocateZeroed(sz); // У типа T д.б. констуктор по умолчанию
+    initRefs();
   }
   TDynamicVector(T* arr, size_t s) : sz(s)
   {
     assert(arr != nullptr && "TDynamicVector ctor requires non-nullptr arg");
-    pMem = new T[sz];
-    std::copy(arr, arr + sz, pMem);
+    if (sz == 0 || sz > MAX_VECTOR_SIZE)
+      throw out_of_range("bad vector size");
+    pMem = allocateCopy(arr, sz);
+    initRefs();
+  }
+  // копия элементов представления
+  explicit TDynamicVector(TVectorView<const T> v) : TDynamicVector(v.size())
+  {
+    ownView().assign(v);
+  }
+  // копия с приведением типа элементов
+  template<typename U, enable_if_t<!is_same<U, T>::value, int> = 0>
+  explicit TDynamicVector(const TDynamicVector<U>& v) : TDynamicVector(v.size())
+  {
+    TConvertKernel<T, U>::run(v.data(), pMem, sz);
   }
   TDynamicVector(const TDynamicVector& v)
   {
     sz = v.sz;
-    pMem = new T[sz];
-    for (size_t i = 0; i < sz; i++)
-      pMem[i] = v.pMem[i];
+    if (canShare(v))
+    {
+      v.refs->fetch_add(1, memory_order_relaxed);
+      pMem = v.pMem;
+      refs = v.refs;
+    }
+    else
+    {
+      pMem = allocateCopy(v.pMem, sz);
+      initRefs();
+    }
   }
   TDynamicVector(TDynamicVector&& v) noexcept
   {
     sz = v.sz;
     pMem = v.pMem;
+    refs = v.refs;
+    unshareable = v.unshareable;
     v.sz = 0;
     v.pMem = nullptr;
+    v.refs = nullptr;
+    v.unshareable = false;
   }
   ~TDynamicVector()
   {
-    delete[] pMem;
+    drop();
   }
   TDynamicVector& operator=(const TDynamicVector& v)
   {
-    if (this != &v)
+    if (this != &v && pMem != v.pMem)
     {
-      if (sz != v.sz)
+      // на элементы выданы ссылки - при том же размере они остаются в силе
+      if (canShare(v) && !(unshareable && sz == v.sz))
       {
-        delete[] pMem;
+        v.refs->fetch_add(1, memory_order_relaxed);
+        drop();
         sz = v.sz;
-        pMem = new T[sz];
+        pMem = v.pMem;
+        refs = v.refs;
+        unshareable = false;
       }
-      for (size_t i = 0; i < sz; i++)
-        pMem[i] = v.pMem[i];
+      else if (sz != v.sz || isShared())
+      {
+        T* p = allocateCopy(v.pMem, v.sz);
+        drop();
+        sz = v.sz;
+        pMem = p;
+        initRefs();
+        unshareable = false;
+      }
+      else
+        copyElements(pMem, v.pMem, sz);
     }
     return *this;
   }
@@ -75,20 +1361,31 @@ public:
   {
     if (this != &v)
     {
-      delete[] pMem;
+      drop();
       sz = v.sz;
       pMem = v.pMem;
+      refs = v.refs;
+      unshareable = v.unshareable;
       v.sz = 0;
       v.pMem = nullptr;
+      v.refs = nullptr;
+      v.unshareable = false;
     }
     return *this;
   }
 
   size_t size() const noexcept { return sz; }
+  T* data()
+  {
+    leak();
+    return pMem;
+  }
+  const T* data() const noexcept { return pMem; }
 
   // индексация
   T& operator[](size_t ind)
   {
+    leak();
     return pMem[ind];
   }
   const T& operator[](size_t ind) const
@@ -100,6 +1397,7 @@ public:
   {
     if (ind >= sz)
       throw out_of_range("bad index");
+    leak();
     return pMem[ind];
   }
   const T& at(size_t ind) const
@@ -109,207 +1407,1005 @@ public:
     return pMem[ind];
   }
 
+  // представления без копирования
+  TVectorView<T> view()
+  {
+    leak();
+    return TVectorView<T>(pMem, sz);
+  }
+  TVectorView<const T> view() const noexcept { return TVectorView<const T>(pMem, sz); }
+  TVectorView<T> slice(size_t offset, size_t length, ptrdiff_t stride = 1)
+  {
+    return view().slice(offset, length, stride);
+  }
+  TVectorView<const T> slice(size_t offset, size_t length, ptrdiff_t stride = 1) const
+  {
+    return view().slice(offset, length, stride);
+  }
+
   // сравнение
-  bool operator==(const TDynamicVector& v) const noexcept
+  bool operator==(const TDynamicVector& v) const
   {
-    if (sz != v.sz)
-      return false;
-    for (size_t i = 0; i < sz; i++)
-      if (pMem[i] != v.pMem[i])
-        return false;
-    return true;
+    return sz == v.sz && TCompare::equal(pMem, v.pMem, sz);
   }
-  bool operator!=(const TDynamicVector& v) const noexcept
+  bool operator!=(const TDynamicVector& v) const
   {
     return !(*this == v);
   }
 
-  // скалярные операции
-  TDynamicVector operator+(T val)
+  // хеш содержимого (xxHash64): равные векторы имеют равные хеши
+  uint64_t hash(uint64_t seed = 0) const
   {
-    TDynamicVector res(sz);
-    for (size_t i = 0; i < sz; i++)
-      res.pMem[i] = pMem[i] + val;
-    return res;
+    THash64 h(seed);
+    h.updateValue((uint64_t)sz);
+    TContentHash::update(h, view());
+    return h.digest();
+  }
+  // контрольная сумма памяти элементов (CRC32C) для проверки целостности
+  uint32_t checksum() const
+  {
+    return TCrc32c().update(pMem, sz * sizeof(T)).digest();
   }
-  TDynamicVector operator-(double val)
+
+  // скалярные операции (тип результата - TScalarPromoteT<T, U>)
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicVector<TScalarPromoteT<T, U>> operator+(const U& val) const
   {
-    TDynamicVector res(sz);
+    using R = TScalarPromoteT<T, U>;
+    TDynamicVector<R> res(sz);
     for (size_t i = 0; i < sz; i++)
-      res.pMem[i] = pMem[i] - (T)val;
+      res[i] = pMem[i] + (R)val;
     return res;
   }
-  TDynamicVector operator*(double val)
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicVector<TScalarPromoteT<T, U>> operator-(const U& val) const
   {
-    TDynamicVector res(sz);
+    using R = TScalarPromoteT<T, U>;
+    TDynamicVector<R> res(sz);
     for (size_t i = 0; i < sz; i++)
-      res.pMem[i] = pMem[i] * (T)val;
+      res[i] = pMem[i] - (R)val;
     return res;
   }
-
-  // векторные операции
-  TDynamicVector operator+(const TDynamicVector& v)
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicVector<TScalarPromoteT<T, U>> operator*(const U& val) const
   {
-    if (sz != v.sz)
-      throw out_of_range("different size");
-    TDynamicVector res(sz);
+    using R = TScalarPromoteT<T, U>;
+    TDynamicVector<R> res(sz);
     for (size_t i = 0; i < sz; i++)
-      res.pMem[i] = pMem[i] + v.pMem[i];
+      res[i] = pMem[i] * (R)val;
     return res;
   }
-  TDynamicVector operator-(const TDynamicVector& v)
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicVector<TScalarPromoteT<T, U>> operator/(const U& val) const
   {
-    if (sz != v.sz)
-      throw out_of_range("different size");
-    TDynamicVector res(sz);
+    using R = TScalarPromoteT<T, U>;
+    TDynamicVector<R> res(sz);
     for (size_t i = 0; i < sz; i++)
-      res.pMem[i] = pMem[i] - v.pMem[i];
+      res[i] = pMem[i] / (R)val;
     return res;
   }
-  T operator*(const TDynamicVector& v) noexcept(noexcept(T()))
+
+  // векторные операции
+  TDynamicVector operator+(TVectorView<const T> v) const
+  {
+    return view() + v;
+  }
+  TDynamicVector operator-(TVectorView<const T> v) const
   {
-    T res = T();
-    size_t min_sz = sz < v.sz ? sz : v.sz;
-    for (size_t i = 0; i < min_sz; i++)
-      res = res + pMem[i] * v.pMem[i];
-    return res;
+    return view() - v;
+  }
+  T operator*(TVectorView<const T> v) const
+  {
+    return view() * v;
+  }
+
+  // поэлементные преобразования
+  template<typename F>
+  TDynamicVector& apply(F f)
+  {
+    ownView().apply(f);
+    return *this;
+  }
+  template<typename F>
+  auto map(F f) const { return view().map(f); }
+
+  // поэлементное (адамарово) умножение и деление
+  TDynamicVector& cwiseMultiply(TVectorView<const T> v)
+  {
+    ownView().cwiseMultiply(v);
+    return *this;
+  }
+  TDynamicVector& cwiseDivide(TVectorView<const T> v)
+  {
+    ownView().cwiseDivide(v);
+    return *this;
   }
+  TDynamicVector cwiseProduct(TVectorView<const T> v) const { return view().cwiseProduct(v); }
+  TDynamicVector cwiseQuotient(TVectorView<const T> v) const { return view().cwiseQuotient(v); }
+
+  // свёртки и нормы
+  T sum() const { return view().sum(); }
+  T min() const { return view().min(); }
+  T max() const { return view().max(); }
+  size_t argmin() const { return view().argmin(); }
+  size_t argmax() const { return view().argmax(); }
+  T norm1() const { return view().norm1(); }
+  auto norm2() const { return view().norm2(); }
+  T normInf() const { return view().normInf(); }
 
   friend void swap(TDynamicVector& lhs, TDynamicVector& rhs) noexcept
   {
     std::swap(lhs.sz, rhs.sz);
     std::swap(lhs.pMem, rhs.pMem);
+    std::swap(lhs.refs, rhs.refs);
+    std::swap(lhs.unshareable, rhs.unshareable);
   }
 
   // ввод/вывод
+  // ввод/вывод (числа - через TTextIO)
   friend istream& operator>>(istream& istr, TDynamicVector& v)
   {
+    v.detach();
+    T* p = v.pMem;
+    if (TTextIO::fastInput<T>(istr))
+    {
+      if constexpr (TTextIO::supported<T>)
+        TTextIO::read<T>(istr, v.sz, [p](size_t k, T x) { p[k] = x; });
+      return istr;
+    }
     for (size_t i = 0; i < v.sz; i++)
-      istr >> v.pMem[i]; // требуется оператор>> для типа T
+      istr >> p[i]; // требуется оператор>> для типа T
     return istr;
   }
   friend ostream& operator<<(ostream& ostr, const TDynamicVector& v)
   {
+    const T* p = v.pMem;
+    if (TTextIO::fastOutput<T>(ostr))
+    {
+      if constexpr (TTextIO::supported<T>)
+        TTextIO::write<T>(ostr, v.sz, 0, [p](size_t k) { return p[k]; });
+      return ostr;
+    }
     for (size_t i = 0; i < v.sz; i++)
-      ostr << v.pMem[i] << ' '; // требуется оператор<< для типа T
+      ostr << p[i] << ' '; // требуется оператор<< для типа T
     return ostr;
   }
 };
 
 
-// Динамическая матрица - 
-// шаблонная матрица на динамической памяти
+// Динамическая матрица -
+// шаблонная матрица на динамической памяти;
+// элементы хранятся одним непрерывным блоком по строкам или по столбцам
 template<typename T>
-class TDynamicMatrix : private TDynamicVector<TDynamicVector<T>>
+class TDynamicMatrix : private TDynamicVector<T>
 {
-  using TDynamicVector<TDynamicVector<T>>::pMem;
-  using TDynamicVector<TDynamicVector<T>>::sz;
+  using TDynamicVector<T>::pMem;
+  using TDynamicVector<T>::sz;
+  using TDynamicVector<T>::detach;
+  using TDynamicVector<T>::leak;
+  size_t nRows, nCols;
+  TMatrixLayout lay;
+
+  static size_t checkedSize(size_t rows, size_t cols)
+  {
+    if (rows == 0 || cols == 0)
+      throw out_of_range("Matrix size should be greater than zero");
+    if (rows > MAX_MATRIX_SIZE || cols > MAX_MATRIX_SIZE)
+      throw out_of_range("Matrix size should be not greater than MAX_MATRIX_SIZE");
+    return rows * cols;
+  }
 public:
-  TDynamicMatrix(size_t s = 1) : TDynamicVector<TDynamicVector<T>>(s)
+  TDynamicMatrix(size_t s = 1) : TDynamicMatrix(s, s) {}
+  TDynamicMatrix(size_t rows, size_t cols, TMatrixLayout layout = TMatrixLayout::RowMajor)
+    : TDynamicVector<T>(checkedSize(rows, cols)), nRows(rows), nCols(cols), lay(layout) {}
+  // копия элементов представления (в том числе со сменой порядка хранения)
+  explicit TDynamicMatrix(TMatrixView<const T> m, TMatrixLayout layout = TMatrixLayout::RowMajor)
+    : TDynamicMatrix(m.rows(), m.cols(), layout)
   {
-    for (size_t i = 0; i < sz; i++)
-      pMem[i] = TDynamicVector<T>(sz);
+    ownView().assign(m);
+  }
+  // копия с приведением типа элементов (порядок хранения сохраняется)
+  template<typename U, enable_if_t<!is_same<U, T>::value, int> = 0>
+  explicit TDynamicMatrix(const TDynamicMatrix<U>& m) : TDynamicMatrix(m.rows(), m.cols(), m.layout())
+  {
+    TConvertKernel<T, U>::run(m.data(), pMem, sz);
+  }
+  TDynamicMatrix(const TDynamicMatrix& m) = default;
+  TDynamicMatrix(TDynamicMatrix&& m) noexcept
+    : TDynamicVector<T>(std::move(m)), nRows(m.nRows), nCols(m.nCols), lay(m.lay)
+  {
+    m.nRows = m.nCols = 0;
+  }
+  TDynamicMatrix& operator=(const TDynamicMatrix& m) = default;
+  TDynamicMatrix& operator=(TDynamicMatrix&& m) noexcept
+  {
+    if (this != &m)
+    {
+      TDynamicVector<T>::operator=(std::move(m));
+      nRows = m.nRows;
+      nCols = m.nCols;
+      lay = m.lay;
+      m.nRows = m.nCols = 0;
+    }
+    return *this;
+  }
+
+  // единичная матрица
+  static TDynamicMatrix identity(size_t n, TMatrixLayout layout = TMatrixLayout::RowMajor)
+  {
+    TDynamicMatrix res(n, n, layout);
+    for (size_t i = 0; i < n; i++)
+      res.pMem[i * (n + 1)] = T(1);
+    return res;
+  }
+
+  size_t size() const noexcept { return nRows; }
+  size_t rows() const noexcept { return nRows; }
+  size_t cols() const noexcept { return nCols; }
+  TMatrixLayout layout() const noexcept { return lay; }
+  using TDynamicVector<T>::data;
+
+  // индексация
+  TVectorView<T> operator[](size_t ind)
+  {
+    return view()[ind];
+  }
+  TVectorView<const T> operator[](size_t ind) const
+  {
+    return view()[ind];
+  }
+  // индексация с контролем
+  T& at(size_t i, size_t j)
+  {
+    return view().at(i, j);
+  }
+  const T& at(size_t i, size_t j) const
+  {
+    return view().at(i, j);
   }
 
-  using TDynamicVector<TDynamicVector<T>>::operator[];
+  // представления без копирования
+  TMatrixView<T> view()
+  {
+    leak();
+    return TMatrixView<T>(pMem, nRows, nCols, rowStride(), colStride());
+  }
+  TMatrixView<const T> view() const noexcept
+  {
+    return TMatrixView<const T>(pMem, nRows, nCols, rowStride(), colStride());
+  }
+  TVectorView<T> row(size_t i) { return view().row(i); }
+  TVectorView<const T> row(size_t i) const { return view().row(i); }
+  TVectorView<T> col(size_t j) { return view().col(j); }
+  TVectorView<const T> col(size_t j) const { return view().col(j); }
+  TMatrixView<T> block(size_t r0, size_t c0, size_t rows, size_t cols)
+  {
+    return view().block(r0, c0, rows, cols);
+  }
+  TMatrixView<const T> block(size_t r0, size_t c0, size_t rows, size_t cols) const
+  {
+    return view().block(r0, c0, rows, cols);
+  }
 
   // сравнение
-  bool operator==(const TDynamicMatrix& m) const noexcept
+  bool operator==(const TDynamicMatrix& m) const
   {
-    if (sz != m.sz)
+    if (nRows != m.nRows || nCols != m.nCols)
       return false;
-    for (size_t i = 0; i < sz; i++)
-      if (pMem[i] != m.pMem[i])
-        return false;
+    if (lay == m.lay)
+      return TDynamicVector<T>::operator==(m);
+    for (size_t i = 0; i < nRows; i++)
+      for (size_t j = 0; j < nCols; j++)
+        if (view()(i, j) != m.view()(i, j))
+          return false;
     return true;
   }
+  bool operator!=(const TDynamicMatrix& m) const
+  {
+    return !(*this == m);
+  }
 
-  // матрично-скалярные операции
-  TDynamicVector<T> operator*(const T& val)
+  // хеш содержимого (xxHash64) по строкам: не зависит от порядка хранения,
+  // равные матрицы имеют равные хеши
+  uint64_t hash(uint64_t seed = 0) const
   {
-    TDynamicVector<T> res(sz * sz);
-    size_t k = 0;
-    for (size_t i = 0; i < sz; i++)
-      for (size_t j = 0; j < sz; j++)
+    return view().hash(seed);
+  }
+  // контрольная сумма памяти элементов (CRC32C) в порядке хранения
+  uint32_t checksum() const
+  {
+    return TCrc32c().update(pMem, sz * sizeof(T)).digest();
+  }
+
+  // матрично-скалярные операции (тип результата - TScalarPromoteT<T, U>);
+  // один параллельный проход по непрерывной памяти
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicMatrix<TScalarPromoteT<T, U>> operator+(const U& val) const
+  {
+    return scalarOp(val, [](const auto& x, const auto& y) { return x + y; });
+  }
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicMatrix<TScalarPromoteT<T, U>> operator-(const U& val) const
+  {
+    return scalarOp(val, [](const auto& x, const auto& y) { return x - y; });
+  }
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicMatrix<TScalarPromoteT<T, U>> operator*(const U& val) const
+  {
+    return scalarOp(val, [](const auto& x, const auto& y) { return x * y; });
+  }
+  template<typename U, enable_if_t<TIsScalarOperand<U>::value, int> = 0>
+  TDynamicMatrix<TScalarPromoteT<T, U>> operator/(const U& val) const
+  {
+    return scalarOp(val, [](const auto& x, const auto& y) { return x / y; });
+  }
+  TDynamicMatrix& operator+=(const T& val)
+  {
+    ownView() += val;
+    return *this;
+  }
+  TDynamicMatrix& operator-=(const T& val)
+  {
+    ownView() -= val;
+    return *this;
+  }
+  TDynamicMatrix& operator*=(const T& val)
+  {
+    ownView() *= val;
+    return *this;
+  }
+  TDynamicMatrix& operator/=(const T& val)
+  {
+    ownView() /= val;
+    return *this;
+  }
+
+  // матрично-векторные операции
+  TDynamicVector<T> operator*(TVectorView<const T> v) const
+  {
+    return view() * v;
+  }
+
+  // матрично-матричные операции
+  TDynamicMatrix operator+(TMatrixView<const T> m) const
+  {
+    return view() + m;
+  }
+  TDynamicMatrix operator-(TMatrixView<const T> m) const
+  {
+    return view() - m;
+  }
+  TDynamicMatrix operator*(TMatrixView<const T> m) const
+  {
+    return view() * m;
+  }
+
+  // поэлементные преобразования
+  template<typename F>
+  TDynamicMatrix& apply(F f)
+  {
+    ownView().apply(f);
+    return *this;
+  }
+  template<typename F>
+  auto map(F f) const { return view().map(f); }
+
+  // поэлементное (адамарово) умножение и деление
+  TDynamicMatrix& cwiseMultiply(TMatrixView<const T> m)
+  {
+    ownView().cwiseMultiply(m);
+    return *this;
+  }
+  TDynamicMatrix& cwiseDivide(TMatrixView<const T> m)
+  {
+    ownView().cwiseDivide(m);
+    return *this;
+  }
+  TDynamicMatrix cwiseProduct(TMatrixView<const T> m) const { return view().cwiseProduct(m); }
+  TDynamicMatrix cwiseQuotient(TMatrixView<const T> m) const { return view().cwiseQuotient(m); }
+
+  // свёртки и нормы
+  T sum() const { return view().sum(); }
+  T min() const { return view().min(); }
+  T max() const { return view().max(); }
+  pair<size_t, size_t> argmin() const { return view().argmin(); }
+  pair<size_t, size_t> argmax() const { return view().argmax(); }
+  T trace() const { return view().trace(); }
+  T norm1() const { return view().norm1(); }
+  T normInf() const { return view().normInf(); }
+  auto normFrobenius() const { return view().normFrobenius(); }
+  TDynamicVector<T> rowSums() const { return view().rowSums(); }
+  TDynamicVector<T> colSums() const { return view().colSums(); }
+
+  // ввод/вывод (в тексте матрица всегда записана по строкам; числа - через TTextIO)
+  friend istream& operator>>(istream& istr, TDynamicMatrix& v)
+  {
+    TMatrixView<T> m = v.ownView();
+    if (TTextIO::fastInput<T>(istr))
+    {
+      if constexpr (TTextIO::supported<T>)
       {
-        res[k] = pMem[i][j] * val;
-        k++;
+        size_t c = v.nCols;
+        if (v.lay == TMatrixLayout::RowMajor)
+          TTextIO::read<T>(istr, v.sz, [&m](size_t k, T x) { m.data()[k] = x; });
+        else
+          TTextIO::read<T>(istr, v.sz, [&m, c](size_t k, T x) { m(k / c, k % c) = x; });
       }
-    return res;
+      return istr;
+    }
+    for (size_t i = 0; i < v.nRows; i++)
+      for (size_t j = 0; j < v.nCols; j++)
+        istr >> m(i, j);
+    return istr;
+  }
+  friend ostream& operator<<(ostream& ostr, const TDynamicMatrix& v)
+  {
+    TMatrixView<const T> m = v.view();
+    if (TTextIO::fastOutput<T>(ostr))
+    {
+      if constexpr (TTextIO::supported<T>)
+      {
+        size_t c = v.nCols;
+        if (v.lay == TMatrixLayout::RowMajor)
+          TTextIO::write<T>(ostr, v.sz, c, [&m](size_t k) { return m.data()[k]; });
+        else
+          TTextIO::write<T>(ostr, v.sz, c, [&m, c](size_t k) { return m(k / c, k % c); });
+      }
+      return ostr;
+    }
+    for (size_t i = 0; i < v.nRows; i++)
+    {
+      for (size_t j = 0; j < v.nCols; j++)
+        ostr << m(i, j) << ' ';
+      ostr << '\n';
+    }
+    return ostr;
   }
 
-  // матрично-векторные операции
-  TDynamicVector<T> operator*(const TDynamicVector<T>& v)
+  // двоичный ввод/вывод: размеры, порядок хранения, затем память как есть
+  void writeBinary(ostream& ostr) const
   {
-    if (v.size() != sz)
-      throw out_of_range("bad size");
-    TDynamicVector<T> res(sz);
-    for (size_t i = 0; i < sz; i++)
+    static_assert(is_trivially_copyable<T>::value, "binary I/O requires trivially copyable T");
+    uint64_t hdr[2] = { nRows, nCols };
+    uint8_t l = (uint8_t)lay;
+    ostr.write((const char*)hdr, sizeof(hdr));
+    ostr.write((const char*)&l, sizeof(l));
+    ostr.write((const char*)pMem, sz * sizeof(T));
+  }
+  // порядок хранения *this сохраняется; при несовпадении с файлом элементы переставляются
+  void readBinary(istream& istr)
+  {
+    static_assert(is_trivially_copyable<T>::value, "binary I/O requires trivially copyable T");
+    uint64_t hdr[2];
+    uint8_t l;
+    istr.read((char*)hdr, sizeof(hdr));
+    istr.read((char*)&l, sizeof(l));
+    if (!istr || l > (uint8_t)TMatrixLayout::ColMajor)
+      throw runtime_error("bad matrix header");
+    TMatrixLayout fileLayout = (TMatrixLayout)l;
+    if (hdr[0] != nRows || hdr[1] != nCols)
+      *this = TDynamicMatrix((size_t)hdr[0], (size_t)hdr[1], lay);
+    detach();
+    if (fileLayout == lay)
+      istr.read((char*)pMem, sz * sizeof(T));
+    else
     {
-      T sum = T();
-      for (size_t j = 0; j < sz; j++)
-        sum = sum + pMem[i][j] * v[j];
-      res[i] = sum;
+      TDynamicMatrix tmp(nRows, nCols, fileLayout);
+      istr.read((char*)tmp.pMem, sz * sizeof(T));
+      ownView().assign(tmp);
     }
-    return res;
+    if (!istr)
+      throw runtime_error("unexpected end of matrix data");
   }
 
-  // матрично-матричные операции
-  TDynamicMatrix operator+(const TDynamicMatrix& m)
+private:
+  // изменяемое представление для собственных операций (буфер остаётся общим)
+  TMatrixView<T> ownView()
   {
-    if (sz != m.sz)
-      throw out_of_range("different size");
-    TDynamicMatrix res(sz);
-    for (size_t i = 0; i < sz; i++)
-      for (size_t j = 0; j < sz; j++)
-        res[i][j] = (*this)[i][j] + m[i][j];
-    return res;
+    detach();
+    return TMatrixView<T>(pMem, nRows, nCols, rowStride(), colStride());
   }
-  TDynamicMatrix operator-(const TDynamicMatrix& m)
+  template<typename U, typename F>
+  TDynamicMatrix<TScalarPromoteT<T, U>> scalarOp(const U& val, F f) const
   {
-    if (sz != m.sz)
-      throw out_of_range("different size");
-    TDynamicMatrix res(sz);
-    for (size_t i = 0; i < sz; i++)
-      for (size_t j = 0; j < sz; j++)
-        res[i][j] = (*this)[i][j] - m[i][j];
-    return res;
+    using R = TScalarPromoteT<T, U>;
+    const R r = (R)val;
+    return view().map([&r, &f](const T& x) { return (R)f((R)x, r); });
+  }
+
+  ptrdiff_t rowStride() const noexcept
+  {
+    return lay == TMatrixLayout::RowMajor ? (ptrdiff_t)nCols : 1;
+  }
+  ptrdiff_t colStride() const noexcept
+  {
+    return lay == TMatrixLayout::RowMajor ? 1 : (ptrdiff_t)nRows;
+  }
+};
+
+
+// Смешанные операции над операндами с разными типами элементов;
+// результат имеет тип TPromoteT, суммы копятся в TAccumulatorT
+template<typename A, typename B> using TMixedVectors = integral_constant<bool,
+  TVectorOperand<A>::value && TVectorOperand<B>::value &&
+  !is_same<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>::value>;
+template<typename A, typename B> using TMixedMatrices = integral_constant<bool,
+  TMatrixOperand<A>::value && TMatrixOperand<B>::value &&
+  !is_same<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>::value>;
+template<typename A, typename B> using TMixedMatrixVector = integral_constant<bool,
+  TMatrixOperand<A>::value && TVectorOperand<B>::value &&
+  !is_same<typename TMatrixOperand<A>::elem, typename TVectorOperand<B>::elem>::value>;
+
+template<typename A, typename B, enable_if_t<TMixedVectors<A, B>::value, int> = 0>
+TDynamicVector<TPromoteT<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>>
+operator+(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>;
+  TVectorView<const typename TVectorOperand<A>::elem> x(a);
+  TVectorView<const typename TVectorOperand<B>::elem> y(b);
+  if (x.size() != y.size())
+    throw out_of_range("different size");
+  TDynamicVector<R> res(x.size());
+  for (size_t i = 0; i < x.size(); i++)
+    res[i] = (R)x[i] + (R)y[i];
+  return res;
+}
+template<typename A, typename B, enable_if_t<TMixedVectors<A, B>::value, int> = 0>
+TDynamicVector<TPromoteT<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>>
+operator-(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>;
+  TVectorView<const typename TVectorOperand<A>::elem> x(a);
+  TVectorView<const typename TVectorOperand<B>::elem> y(b);
+  if (x.size() != y.size())
+    throw out_of_range("different size");
+  TDynamicVector<R> res(x.size());
+  for (size_t i = 0; i < x.size(); i++)
+    res[i] = (R)x[i] - (R)y[i];
+  return res;
+}
+template<typename A, typename B, enable_if_t<TMixedVectors<A, B>::value, int> = 0>
+TPromoteT<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>
+operator*(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TVectorOperand<A>::elem, typename TVectorOperand<B>::elem>;
+  TVectorView<const typename TVectorOperand<A>::elem> x(a);
+  return (R)x.template dot<TAccumulatorT<R>>(TVectorView<const typename TVectorOperand<B>::elem>(b));
+}
+
+template<typename A, typename B, enable_if_t<TMixedMatrixVector<A, B>::value, int> = 0>
+TDynamicVector<TPromoteT<typename TMatrixOperand<A>::elem, typename TVectorOperand<B>::elem>>
+operator*(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TMatrixOperand<A>::elem, typename TVectorOperand<B>::elem>;
+  TMatrixView<const typename TMatrixOperand<A>::elem> m(a);
+  TVectorView<const typename TVectorOperand<B>::elem> v(b);
+  if (v.size() != m.cols())
+    throw out_of_range("bad size");
+  TDynamicVector<R> res(m.rows());
+  for (size_t i = 0; i < m.rows(); i++)
+    res[i] = (R)m[i].template dot<TAccumulatorT<R>>(v);
+  return res;
+}
+
+template<typename A, typename B, enable_if_t<TMixedMatrices<A, B>::value, int> = 0>
+TDynamicMatrix<TPromoteT<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>>
+operator+(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>;
+  TMatrixView<const typename TMatrixOperand<A>::elem> x(a);
+  TMatrixView<const typename TMatrixOperand<B>::elem> y(b);
+  if (x.rows() != y.rows() || x.cols() != y.cols())
+    throw out_of_range("different size");
+  TDynamicMatrix<R> res(x.rows(), x.cols(), x.layout());
+  TMatrixView<R> r = res.view();
+  for (size_t i = 0; i < x.rows(); i++)
+    for (size_t j = 0; j < x.cols(); j++)
+      r(i, j) = (R)x(i, j) + (R)y(i, j);
+  return res;
+}
+template<typename A, typename B, enable_if_t<TMixedMatrices<A, B>::value, int> = 0>
+TDynamicMatrix<TPromoteT<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>>
+operator-(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>;
+  TMatrixView<const typename TMatrixOperand<A>::elem> x(a);
+  TMatrixView<const typename TMatrixOperand<B>::elem> y(b);
+  if (x.rows() != y.rows() || x.cols() != y.cols())
+    throw out_of_range("different size");
+  TDynamicMatrix<R> res(x.rows(), x.cols(), x.layout());
+  TMatrixView<R> r = res.view();
+  for (size_t i = 0; i < x.rows(); i++)
+    for (size_t j = 0; j < x.cols(); j++)
+      r(i, j) = (R)x(i, j) - (R)y(i, j);
+  return res;
+}
+// более узкий операнд приводится к R один раз (O(n^2)), произведение считается в R
+template<typename A, typename B, enable_if_t<TMixedMatrices<A, B>::value, int> = 0>
+TDynamicMatrix<TPromoteT<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>>
+operator*(const A& a, const B& b)
+{
+  using R = TPromoteT<typename TMatrixOperand<A>::elem, typename TMatrixOperand<B>::elem>;
+  TMatrixView<const typename TMatrixOperand<A>::elem> x(a);
+  TMatrixView<const typename TMatrixOperand<B>::elem> y(b);
+  if (x.cols() != y.rows())
+    throw out_of_range("different size");
+  TDynamicMatrix<R> xr(x.rows(), x.cols(), x.layout()), yr(y.rows(), y.cols(), y.layout());
+  for (size_t i = 0; i < x.rows(); i++)
+    for (size_t j = 0; j < x.cols(); j++)
+      xr.view()(i, j) = (R)x(i, j);
+  for (size_t i = 0; i < y.rows(); i++)
+    for (size_t j = 0; j < y.cols(); j++)
+      yr.view()(i, j) = (R)y(i, j);
+  return xr * yr;
+}
+
+// Поэлементное объединение двух векторов или матриц одной формы: r[i] = f(a[i], b[i])
+template<typename A, typename B, typename F,
+  enable_if_t<TVectorOperand<A>::value && TVectorOperand<B>::value, int> = 0>
+auto zip(const A& a, const B& b, F f)
+{
+  using EA = typename TVectorOperand<A>::elem;
+  using EB = typename TVectorOperand<B>::elem;
+  using R = decay_t<invoke_result_t<F&, const EA&, const EB&>>;
+  TVectorView<const EA> x(a);
+  TVectorView<const EB> y(b);
+  if (x.size() != y.size())
+    throw out_of_range("different size");
+  TDynamicVector<R> res(x.size());
+  TVectorView<R> r = res.view();
+  TParallel::forRange(x.size(), TParallel::GRAIN, [&](size_t first, size_t last) {
+    size_t n = last - first;
+    r.slice(first, n).assignZipped(x.slice(first, n), y.slice(first, n), f);
+  });
+  return res;
+}
+template<typename A, typename B, typename F,
+  enable_if_t<TMatrixOperand<A>::value && TMatrixOperand<B>::value, int> = 0>
+auto zip(const A& a, const B& b, F f)
+{
+  using EA = typename TMatrixOperand<A>::elem;
+  using EB = typename TMatrixOperand<B>::elem;
+  using R = decay_t<invoke_result_t<F&, const EA&, const EB&>>;
+  TMatrixView<const EA> x(a);
+  TMatrixView<const EB> y(b);
+  TDynamicMatrix<R> res(x.rows(), x.cols(), x.layout());
+  res.view().assignZipped(x, y, f);
+  return res;
+}
+
+// адамарово произведение
+template<typename A, typename B,
+  enable_if_t<(TVectorOperand<A>::value && TVectorOperand<B>::value) ||
+              (TMatrixOperand<A>::value && TMatrixOperand<B>::value), int> = 0>
+auto hadamard(const A& a, const B& b)
+{
+  return zip(a, b, [](const auto& x, const auto& y) { return x * y; });
+}
+
+// приближённое равенство: |a - b| <= atol + rtol * |b| поэлементно;
+// при разных размерах - false
+template<typename A, typename B,
+  enable_if_t<TVectorOperand<A>::value && TVectorOperand<B>::value, int> = 0>
+bool allclose(const A& a, const B& b, double rtol = 1e-5, double atol = 1e-8)
+{
+  return TCompare::close(TVectorView<const typename TVectorOperand<A>::elem>(a),
+    TVectorView<const typename TVectorOperand<B>::elem>(b), rtol, atol);
+}
+template<typename A, typename B,
+  enable_if_t<TMatrixOperand<A>::value && TMatrixOperand<B>::value, int> = 0>
+bool allclose(const A& a, const B& b, double rtol = 1e-5, double atol = 1e-8)
+{
+  TMatrixView<const typename TMatrixOperand<A>::elem> x(a);
+  TMatrixView<const typename TMatrixOperand<B>::elem> y(b);
+  if (x.rows() != y.rows() || x.cols() != y.cols())
+    return false;
+  if (x.isContiguous() && y.isContiguous() && x.layout() == y.layout())
+    return TCompare::close(x.flat(), y.flat(), rtol, atol);
+  for (size_t i = 0; i < x.rows(); i++)
+    if (!TCompare::close(x[i], y[i], rtol, atol))
+      return false;
+  return true;
+}
+
+// LU-разложение с выбором ведущего элемента по столбцу: P A = L U;
+// L (с единичной диагональю) и U хранятся в одной матрице
+template<typename T>
+class TLUDecomposition
+{
+  TDynamicMatrix<T> lu;
+  vector<size_t> perm; // строка i матрицы P A - строка perm[i] матрицы A
+public:
+  explicit TLUDecomposition(TMatrixView<const T> a) : lu(a), perm(a.rows())
+  {
+    size_t n = a.rows();
+    if (a.cols() != n)
+      throw out_of_range("matrix is not square");
+    for (size_t i = 0; i < n; i++)
+      perm[i] = i;
+    T* l = lu.data();
+    for (size_t c = 0; c < n; c++)
+    {
+      size_t p = c;
+      for (size_t i = c + 1; i < n; i++)
+        if (absValue(l[p * n + c]) < absValue(l[i * n + c]))
+          p = i;
+      if (l[p * n + c] == T())
+        throw runtime_error("singular matrix");
+      if (p != c)
+      {
+        swap_ranges(l + c * n, l + (c + 1) * n, l + p * n);
+        swap(perm[c], perm[p]);
+      }
+      // исключение под ведущим элементом, строки независимы; множители - на месте нулей
+      TParallel::forRange(n - c - 1, max<size_t>(1, TParallel::GRAIN / n), [&](size_t first, size_t last) {
+        for (size_t i = c + 1 + first; i < c + 1 + last; i++)
+        {
+          T f = l[i * n + c] / l[c * n + c];
+          l[i * n + c] = f;
+          for (size_t j = c + 1; j < n; j++)
+            l[i * n + j] = l[i * n + j] - f * l[c * n + j];
+        }
+      });
+    }
   }
-  TDynamicMatrix operator*(const TDynamicMatrix& m)
+
+  size_t size() const noexcept { return perm.size(); }
+  const TDynamicMatrix<T>& factors() const noexcept { return lu; }
+  const vector<size_t>& permutation() const noexcept { return perm; }
+
+  // X = A^-1 B: прямой ход по L и обратный по U, столбцы правой части независимы
+  TDynamicMatrix<T> solve(TMatrixView<const T> b) const
   {
-    if (sz != m.sz)
+    size_t n = size();
+    if (b.rows() != n)
       throw out_of_range("different size");
-    TDynamicMatrix res(sz);
-    for (size_t i = 0; i < sz; i++)
-      for (size_t j = 0; j < sz; j++)
+    size_t k = b.cols();
+    TDynamicMatrix<T> x(n, k);
+    for (size_t i = 0; i < n; i++)
+      x[i].assign(b[perm[i]]);
+    const T* l = lu.data();
+    T* r = x.data();
+    TParallel::forRange(k, max<size_t>(1, TParallel::GRAIN / (n * n)), [&](size_t first, size_t last) {
+      for (size_t c = 1; c < n; c++)
+        for (size_t i = 0; i < c; i++)
+          for (size_t j = first; j < last; j++)
+            r[c * k + j] = r[c * k + j] - l[c * n + i] * r[i * k + j];
+      for (size_t c = n; c-- > 0;)
       {
-        T sum = T();
-        for (size_t k = 0; k < sz; k++)
-          sum = sum + (*this)[i][k] * m[k][j];
-        res[i][j] = sum;
+        for (size_t i = c + 1; i < n; i++)
+          for (size_t j = first; j < last; j++)
+            r[c * k + j] = r[c * k + j] - l[c * n + i] * r[i * k + j];
+        for (size_t j = first; j < last; j++)
+          r[c * k + j] = r[c * k + j] / l[c * n + c];
       }
+    });
+    return x;
+  }
+  TDynamicVector<T> solve(TVectorView<const T> b) const
+  {
+    TDynamicMatrix<T> x = solve(TMatrixView<const T>(b.data(), b.size(), 1, b.stride(), 1));
+    return TDynamicVector<T>(x.col(0));
+  }
+  TDynamicMatrix<T> inverse() const
+  {
+    return solve(TDynamicMatrix<T>::identity(size()));
+  }
+};
+
+// LU-разложение и обратная матрица; при включённом TMemoCache запоминаются
+template<typename A, enable_if_t<TMatrixOperand<A>::value, int> = 0>
+TLUDecomposition<typename TMatrixOperand<A>::elem> lu(const A& a)
+{
+  using T = typename TMatrixOperand<A>::elem;
+  TMatrixView<const T> m(a);
+  if (!TMemoCache::enabled)
+    return TLUDecomposition<T>(m);
+  return *TMemoCache::instance().getOrCompute<TLUDecomposition<T>>(makeMemoKey<T>(TMemoOp::LU, 0, m),
+    m.rows() * m.cols() * sizeof(T) + m.rows() * sizeof(size_t), [&] { return TLUDecomposition<T>(m); });
+}
+template<typename A, enable_if_t<TMatrixOperand<A>::value, int> = 0>
+TDynamicMatrix<typename TMatrixOperand<A>::elem> inverse(const A& a)
+{
+  using T = typename TMatrixOperand<A>::elem;
+  TMatrixView<const T> m(a);
+  if (!TMemoCache::enabled)
+    return TLUDecomposition<T>(m).inverse();
+  return *TMemoCache::instance().getOrCompute<TDynamicMatrix<T>>(makeMemoKey<T>(TMemoOp::Inverse, 0, m),
+    m.rows() * m.cols() * sizeof(T), [&] { return lu(m).inverse(); });
+}
+
+// Решение системы A X = B (или A x = b)
+template<typename A, typename B,
+  enable_if_t<TMatrixOperand<A>::value && TMatrixOperand<B>::value, int> = 0>
+TDynamicMatrix<typename TMatrixOperand<A>::elem> solve(const A& a, const B& b)
+{
+  return lu(a).solve(TMatrixView<const typename TMatrixOperand<A>::elem>(b));
+}
+template<typename A, typename B,
+  enable_if_t<TMatrixOperand<A>::value && TVectorOperand<B>::value, int> = 0>
+TDynamicVector<typename TMatrixOperand<A>::elem> solve(const A& a, const B& b)
+{
+  return lu(a).solve(TVectorView<const typename TMatrixOperand<A>::elem>(b));
+}
+
+// Функции от квадратной матрицы
+// (промежуточные произведения не запоминаются в TMemoCache, чтобы не вытеснять
+// из него результаты пользователя)
+
+template<typename T>
+TDynamicMatrix<T> multiplyUncached(TMatrixView<const T> a, TMatrixView<const T> b)
+{
+  return a.multiply(b);
+}
+
+// A^k возведением в квадрат: не больше 2 log2(k) умножений
+template<typename A, enable_if_t<TMatrixOperand<A>::value, int> = 0>
+TDynamicMatrix<typename TMatrixOperand<A>::elem> pow(const A& a, size_t k)
+{
+  using T = typename TMatrixOperand<A>::elem;
+  TMatrixView<const T> m(a);
+  if (m.rows() != m.cols())
+    throw out_of_range("matrix is not square");
+  if (k == 0)
+    return TDynamicMatrix<T>::identity(m.rows(), m.layout());
+  TDynamicMatrix<T> base(m, m.layout());
+  for (; !(k & 1); k >>= 1)
+    base = multiplyUncached<T>(base, base);
+  TDynamicMatrix<T> res(base);
+  while (k >>= 1)
+  {
+    base = multiplyUncached<T>(base, base);
+    if (k & 1)
+      res = multiplyUncached<T>(res, base);
+  }
+  return res;
+}
+
+// p(A) = c[0] I + c[1] A + ... + c[d] A^d по схеме Патерсона - Стокмейера:
+// p(A) = sum_j B_j (A^s)^j, где B_j - многочлены степени < s от A, s ~ sqrt(d);
+// A^2..A^s и схема Горнера по A^s дают ~2 sqrt(d) умножений вместо d
+template<typename A, typename C,
+  enable_if_t<TMatrixOperand<A>::value && TVectorOperand<C>::value, int> = 0>
+TDynamicMatrix<typename TMatrixOperand<A>::elem> polyval(const A& a, const C& coeffs)
+{
+  using T = typename TMatrixOperand<A>::elem;
+  TMatrixView<const T> m(a);
+  TVectorView<const typename TVectorOperand<C>::elem> c(coeffs);
+  size_t n = m.rows();
+  if (m.cols() != n)
+    throw out_of_range("matrix is not square");
+  TDynamicMatrix<T> res(n, n, m.layout());
+  if (c.size() == 0)
     return res;
+  size_t d = c.size() - 1;
+  size_t s = max<size_t>(1, (size_t)std::sqrt((double)d));
+  vector<TDynamicMatrix<T>> pw; // A^1..A^s
+  pw.reserve(s);
+  pw.emplace_back(m, m.layout());
+  for (size_t i = 1; i < s; i++)
+    pw.push_back(multiplyUncached<T>(pw.back(), pw.front()));
+  // res += B_j
+  auto addBlock = [&](size_t j) {
+    size_t first = j * s, last = min(d + 1, first + s);
+    for (size_t i = first + 1; i < last; i++)
+    {
+      T ci = (T)c[i];
+      res.view().apply(pw[i - first - 1].view(), [ci](const T& x, const T& y) { return x + ci * y; });
+    }
+    for (size_t i = 0; i < n; i++)
+      res[i][i] = res[i][i] + (T)c[first];
+  };
+  size_t r = d / s;
+  addBlock(r);
+  for (size_t j = r; j-- > 0;)
+  {
+    res = multiplyUncached<T>(res, pw.back());
+    addBlock(j);
   }
+  return res;
+}
 
-  // ввод/вывод
-  friend istream& operator>>(istream& istr, TDynamicMatrix& v)
+// e^A масштабированием и возведением в квадрат с аппроксимацией Паде (Higham, 2005):
+// степень Паде 3..13 выбирается по ||A||_1, при большой норме A делится на 2^s,
+// а результат s раз возводится в квадрат; вычисления ведутся в TAccumulatorT<T>
+template<typename A, enable_if_t<TMatrixOperand<A>::value, int> = 0>
+TDynamicMatrix<typename TMatrixOperand<A>::elem> expm(const A& a)
+{
+  using T = typename TMatrixOperand<A>::elem;
+  using W = TAccumulatorT<T>;
+  static_assert(is_floating_point<W>::value, "expm requires floating-point elements");
+  static const double theta[] = { 1.495585217958292e-2, 2.539398330063230e-1,
+    9.504178996162932e-1, 2.097847961257068, 5.371920351148152 };
+  static const double pade[][14] = {
+    { 120, 60, 12, 1 },
+    { 30240, 15120, 3360, 420, 30, 1 },
+    { 17297280, 8648640, 1995840, 277200, 25200, 1512, 56, 1 },
+    { 17643225600, 8821612800, 2075673600, 302702400, 30270240, 2162160, 110880, 3960, 90, 1 },
+    { 64764752532480000, 32382376266240000, 7771770303897600, 1187353796428800,
+      129060195264000, 10559470521600, 670442572800, 33522128640, 1323241920,
+      40840800, 960960, 16380, 182, 1 } };
+
+  TMatrixView<const T> m(a);
+  size_t n = m.rows();
+  if (m.cols() != n)
+    throw out_of_range("matrix is not square");
+  TDynamicMatrix<W> x(n, n, m.layout());
+  x.view().assignMapped(m, [](const T& v) { return (W)v; });
+
+  // c0 I + sum c[i] p[i]
+  auto comb = [&](double c0, initializer_list<double> c, initializer_list<const TDynamicMatrix<W>*> p) {
+    TDynamicMatrix<W> r(n, n, x.layout());
+    const TDynamicMatrix<W>* const* pm = p.begin();
+    for (double ci : c)
+    {
+      W w = (W)ci;
+      r.view().apply((*pm++)->view(), [w](const W& u, const W& v) { return u + w * v; });
+    }
+    for (size_t i = 0; i < n; i++)
+      r[i][i] = r[i][i] + (W)c0;
+    return r;
+  };
+
+  W norm = x.norm1();
+  TDynamicMatrix<W> u(n, n, x.layout()), v(n, n, x.layout());
+  TDynamicMatrix<W> a2 = multiplyUncached<W>(x, x);
+  int squarings = 0;
+  if (norm <= (W)theta[3])
   {
-    for (size_t i = 0; i < v.sz; i++)
-      for (size_t j = 0; j < v.sz; j++)
-        istr >> v.pMem[i][j];
-    return istr;
+    size_t q = 0;
+    while (norm > (W)theta[q])
+      q++;
+    const double* b = pade[q];
+    TDynamicMatrix<W> a4(1), a6(1), a8(1);
+    if (q >= 1)
+      a4 = multiplyUncached<W>(a2, a2);
+    if (q >= 2)
+      a6 = multiplyUncached<W>(a4, a2);
+    if (q >= 3)
+      a8 = multiplyUncached<W>(a6, a2);
+    switch (q)
+    {
+    case 0:
+      u = multiplyUncached<W>(x, comb(b[1], { b[3] }, { &a2 }));
+      v = comb(b[0], { b[2] }, { &a2 });
+      break;
+    case 1:
+      u = multiplyUncached<W>(x, comb(b[1], { b[3], b[5] }, { &a2, &a4 }));
+      v = comb(b[0], { b[2], b[4] }, { &a2, &a4 });
+      break;
+    case 2:
+      u = multiplyUncached<W>(x, comb(b[1], { b[3], b[5], b[7] }, { &a2, &a4, &a6 }));
+      v = comb(b[0], { b[2], b[4], b[6] }, { &a2, &a4, &a6 });
+      break;
+    default:
+      u = multiplyUncached<W>(x, comb(b[1], { b[3], b[5], b[7], b[9] }, { &a2, &a4, &a6, &a8 }));
+      v = comb(b[0], { b[2], b[4], b[6], b[8] }, { &a2, &a4, &a6, &a8 });
+    }
   }
-  friend ostream& operator<<(ostream& ostr, const TDynamicMatrix& v)
+  else
   {
-    for (size_t i = 0; i < v.sz; i++)
+    squarings = max(0, (int)std::ceil(std::log2((double)norm / theta[4])));
+    if (squarings > 0)
     {
-      for (size_t j = 0; j < v.sz; j++)
-        ostr << v.pMem[i][j] << ' ';
-      ostr << endl;
+      x *= (W)std::ldexp(1.0, -squarings);
+      a2 *= (W)std::ldexp(1.0, -2 * squarings);
     }
-    return ostr;
+    const double* b = pade[4];
+    TDynamicMatrix<W> a4 = multiplyUncached<W>(a2, a2), a6 = multiplyUncached<W>(a4, a2);
+    u = multiplyUncached<W>(x, multiplyUncached<W>(a6, comb(0, { b[13], b[11], b[9] }, { &a6, &a4, &a2 })) +
+      comb(b[1], { b[7], b[5], b[3] }, { &a6, &a4, &a2 }));
+    v = multiplyUncached<W>(a6, comb(0, { b[12], b[10], b[8] }, { &a6, &a4, &a2 })) +
+      comb(b[0], { b[6], b[4], b[2] }, { &a6, &a4, &a2 });
   }
-};
+  // r = (V - U)^-1 (V + U)
+  TDynamicMatrix<W> res = TLUDecomposition<W>(v - u).solve(v + u);
+  for (int i = 0; i < squarings; i++)
+    res = multiplyUncached<W>(res, res);
+  if constexpr (is_same<W, T>::value)
+    return res;
+  else
+    return TDynamicMatrix<T>(res);
+}
 
 #endif
-
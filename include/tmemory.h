@@ -0,0 +1,283 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Выделение памяти под элементы векторов и матриц
+//
+
+#ifndef __TMemory_H__
+#define __TMemory_H__
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <new>
+#include <string>
+#include <vector>
+#include "tparallel.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Размещение больших массивов по узлам NUMA:
+// None       - страницы достаются узлу потока, который первым их записал;
+// Interleave - страницы явно чередуются по всем узлам (mbind)
+// (размещения по узлам ядер нет: потоки TThreadPool не закреплены за ядрами,
+// а отрезки TParallel::forRange разбираются кражей работы)
+enum class TNumaPolicy { None, Interleave };
+
+// Страницы больших массивов:
+// Normal      - обычные страницы по 4К;
+// Transparent - прозрачные большие страницы: область выравнивается на 2М и помечается
+//               madvise(MADV_HUGEPAGE), ядро собирает её из 2М страниц по возможности;
+// Explicit    - страницы hugetlbfs (mmap с MAP_HUGETLB): 1Г для массивов от 1Г, иначе 2М;
+//               если таких страниц в системе нет - как Transparent
+enum class THugePages { Normal, Transparent, Explicit };
+
+struct TMemory
+{
+  static inline TNumaPolicy numa = TNumaPolicy::None;
+  static inline THugePages hugePages = THugePages::Normal;
+  // копирование при записи: векторы и матрицы, созданные при включённом режиме,
+  // копируются за O(1) - копии делят буфер со счётчиком ссылок, а своя копия
+  // элементов делается при первом изменяющем обращении (неконстантные data(), [], at, view());
+  // буфер, на который такое обращение выдало ссылку или представление, больше не делится
+  static inline bool copyOnWrite = false;
+  // политики размещения действуют на массивы от LARGE байт
+  static constexpr size_t LARGE = 1 << 21;
+  static constexpr size_t PAGE = 4096;
+  static constexpr size_t HUGE_PAGE = 1 << 21;
+  static constexpr size_t GIGA_PAGE = 1 << 30;
+  static constexpr size_t CACHE_LINE = 64;
+  // заполнение и копирование массивов от PARALLEL байт - в несколько потоков,
+  // копирование от STREAM байт (больше кэша последнего уровня) - потоковой записью
+  static constexpr size_t PARALLEL = 1 << 22;
+  static constexpr size_t STREAM = 1 << 25;
+
+  static bool isLarge(size_t bytes) noexcept { return bytes >= LARGE; }
+  // заполнять ли массив параллельно
+  static bool spread(size_t bytes) noexcept
+  {
+    return bytes >= PARALLEL || (numa == TNumaPolicy::Interleave && isLarge(bytes));
+  }
+
+  // копирование байтов; при stream запись идёт мимо кэша (без чтения строк приёмника)
+  static void copy(void* dst, const void* src, size_t bytes, bool stream) noexcept
+  {
+#if defined(__SSE2__)
+    if (stream && bytes >= 4 * CACHE_LINE)
+    {
+      char* d = static_cast<char*>(dst);
+      const char* s = static_cast<const char*>(src);
+      size_t head = (16 - reinterpret_cast<uintptr_t>(d) % 16) % 16;
+      std::memcpy(d, s, head);
+      d += head;
+      s += head;
+      bytes -= head;
+      size_t body = bytes / CACHE_LINE * CACHE_LINE;
+      for (size_t i = 0; i < body; i += CACHE_LINE)
+      {
+        __m128i x0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i));
+        __m128i x1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 16));
+        __m128i x2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 32));
+        __m128i x3 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(s + i + 48));
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + i), x0);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 16), x1);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 32), x2);
+        _mm_stream_si128(reinterpret_cast<__m128i*>(d + i + 48), x3);
+      }
+      _mm_sfence();
+      std::memcpy(d + body, s + body, bytes - body);
+      return;
+    }
+#else
+    (void)stream;
+#endif
+    std::memcpy(dst, src, bytes);
+  }
+
+  // массивы выделяются new с выравниванием на строку кэша, большие - на страницу;
+  // при больших страницах большие массивы отображаются в память (mmap)
+  static void* allocate(size_t bytes)
+  {
+    if (!isLarge(bytes))
+      return ::operator new(bytes, std::align_val_t(CACHE_LINE));
+    void* p = hugePages != THugePages::Normal ? map(bytes) : nullptr;
+    if (!p)
+      p = ::operator new(bytes, std::align_val_t(PAGE));
+    if (numa == TNumaPolicy::Interleave)
+      interleave(p, bytes);
+    return p;
+  }
+  static void release(void* p, size_t bytes) noexcept
+  {
+    if (!isLarge(bytes))
+      ::operator delete(p, std::align_val_t(CACHE_LINE));
+    else if (mappedCount.load(std::memory_order_acquire) == 0 || !unmap(p))
+      ::operator delete(p, std::align_val_t(PAGE));
+  }
+
+private:
+  static size_t roundUp(size_t bytes, size_t page) noexcept { return (bytes + page - 1) / page * page; }
+
+  // число отображённых областей: без них освобождение не берёт мьютекс
+  static inline std::atomic<size_t> mappedCount{ 0 };
+  // отображённые области и их длины (политика могла смениться до освобождения)
+  static std::map<void*, size_t>& mappings() noexcept
+  {
+    static std::map<void*, size_t> m;
+    return m;
+  }
+  static std::mutex& mappingsMutex() noexcept
+  {
+    static std::mutex m;
+    return m;
+  }
+
+  // область под bytes байт по политике hugePages (не Normal); nullptr - если mmap недоступен
+  static void* map(size_t bytes) noexcept
+  {
+#if defined(__linux__)
+    void* p = MAP_FAILED;
+    size_t len = 0;
+#if defined(MAP_HUGETLB)
+    if (hugePages == THugePages::Explicit)
+    {
+      const int HUGE_SHIFT = 26; // MAP_HUGE_SHIFT
+      if (bytes >= GIGA_PAGE)
+      {
+        len = roundUp(bytes, GIGA_PAGE);
+        p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (30 << HUGE_SHIFT), -1, 0);
+      }
+      if (p == MAP_FAILED)
+      {
+        len = roundUp(bytes, HUGE_PAGE);
+        p = mmap(nullptr, len, PROT_READ | PROT_WRITE,
+          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (21 << HUGE_SHIFT), -1, 0);
+      }
+    }
+#endif
+    if (p == MAP_FAILED)
+    {
+      const size_t align = HUGE_PAGE;
+      len = roundUp(bytes, align);
+      // с запасом на выравнивание; лишнее по краям возвращается системе
+      size_t extra = align - PAGE;
+      void* raw = mmap(nullptr, len + extra, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (raw == MAP_FAILED)
+        return nullptr;
+      char* first = static_cast<char*>(raw);
+      char* aligned = reinterpret_cast<char*>(roundUp(reinterpret_cast<uintptr_t>(first), align));
+      if (aligned > first)
+        munmap(first, aligned - first);
+      if (first + extra > aligned)
+        munmap(aligned + len, first + extra - aligned);
+      p = aligned;
+#if defined(MADV_HUGEPAGE)
+      madvise(p, len, MADV_HUGEPAGE);
+#endif
+    }
+    try
+    {
+      std::lock_guard<std::mutex> lock(mappingsMutex());
+      mappings()[p] = len;
+      mappedCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    catch (...)
+    {
+      munmap(p, len);
+      return nullptr;
+    }
+    return p;
+#else
+    (void)bytes;
+    return nullptr;
+#endif
+  }
+  static bool unmap(void* p) noexcept
+  {
+#if defined(__linux__)
+    size_t len;
+    {
+      std::lock_guard<std::mutex> lock(mappingsMutex());
+      auto it = mappings().find(p);
+      if (it == mappings().end())
+        return false;
+      len = it->second;
+      mappings().erase(it);
+      mappedCount.fetch_sub(1, std::memory_order_relaxed);
+    }
+    munmap(p, len);
+    return true;
+#else
+    (void)p;
+    return false;
+#endif
+  }
+
+  // MPOL_INTERLEAVE по узлам из /sys/devices/system/node/online;
+  // при ошибке страницы размещаются по первому касанию
+  static void interleave(void* p, size_t bytes) noexcept
+  {
+#if defined(__linux__) && defined(SYS_mbind)
+    static const std::vector<unsigned long> mask = onlineNodes();
+    if (mask.empty())
+      return;
+    const int MPOL_INTERLEAVE_ = 3;
+    syscall(SYS_mbind, p, bytes, MPOL_INTERLEAVE_, mask.data(), mask.size() * 8 * sizeof(unsigned long), 0u);
+#else
+    (void)p;
+    (void)bytes;
+#endif
+  }
+  // маска узлов по списку вида "0-1,3"; пустая, если узел один или список недоступен
+  static std::vector<unsigned long> onlineNodes() noexcept
+  {
+    std::vector<unsigned long> mask;
+    std::ifstream f("/sys/devices/system/node/online");
+    std::string list;
+    if (!(f >> list))
+      return mask;
+    size_t count = 0, pos = 0;
+    try
+    {
+      while (pos < list.size())
+      {
+        size_t end = list.find(',', pos);
+        if (end == std::string::npos)
+          end = list.size();
+        std::string range = list.substr(pos, end - pos);
+        size_t dash = range.find('-');
+        unsigned long first = std::stoul(range.substr(0, dash));
+        unsigned long last = dash == std::string::npos ? first : std::stoul(range.substr(dash + 1));
+        const size_t BITS = 8 * sizeof(unsigned long);
+        for (unsigned long n = first; n <= last; n++, count++)
+        {
+          if (mask.size() <= n / BITS)
+            mask.resize(n / BITS + 1);
+          mask[n / BITS] |= 1ul << (n % BITS);
+        }
+        pos = end + 1;
+      }
+    }
+    catch (...)
+    {
+      count = 0;
+    }
+    if (count < 2)
+      mask.clear();
+    return mask;
+  }
+};
+
+#endif
@@ -0,0 +1,699 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Обмен с NumPy: форматы .npy и .npz
+//
+
+#ifndef __TNpy_H__
+#define __TNpy_H__
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+#include "thash.h"
+#include "tmatrix.h"
+
+#if defined(__linux__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// .npy - "\x93NUMPY", версия, длина и заголовок-словарь Python
+// {'descr': '<f8', 'fortran_order': False, 'shape': (3, 4), }, затем элементы подряд;
+// заголовок дополняется пробелами так, чтобы данные начинались с границы 64 байт.
+// Тип элементов должен совпадать с T по виду и размеру; обратный порядок байт
+// переставляется при чтении. Матрица читается в порядке хранения файла:
+// fortran_order - по столбцам, иначе по строкам - одним чтением без перестановок
+struct TNpy
+{
+  struct THeader
+  {
+    string descr;
+    bool fortranOrder = false;
+    vector<size_t> shape;
+
+    // число элементов; размерности из файла не должны переполнять size_t
+    size_t count() const
+    {
+      size_t n = 1;
+      for (size_t d : shape)
+      {
+        if (d != 0 && n > numeric_limits<size_t>::max() / d)
+          throw runtime_error("NPY shape is too large");
+        n *= d;
+      }
+      return n;
+    }
+    // размер данных в байтах при размере элемента elem
+    size_t bytes(size_t elem) const
+    {
+      size_t n = count();
+      if (n > numeric_limits<size_t>::max() / elem)
+        throw runtime_error("NPY shape is too large");
+      return n * elem;
+    }
+  };
+
+  static bool littleEndian() noexcept
+  {
+    uint16_t x = 1;
+    unsigned char c;
+    memcpy(&c, &x, 1);
+    return c == 1;
+  }
+  template<typename T>
+  static string descr()
+  {
+    static_assert(is_arithmetic<T>::value, "NPY I/O requires arithmetic T");
+    char kind = is_same<T, bool>::value ? 'b' : is_floating_point<T>::value ? 'f' : is_signed<T>::value ? 'i' : 'u';
+    char order = sizeof(T) == 1 ? '|' : littleEndian() ? '<' : '>';
+    return string(1, order) + kind + to_string(sizeof(T));
+  }
+  // нужна ли перестановка байт; при несовпадении типа - исключение
+  template<typename T>
+  static bool swapped(const THeader& h)
+  {
+    string mine = descr<T>();
+    if (h.descr.size() == mine.size() && h.descr.compare(1, string::npos, mine, 1, string::npos) == 0)
+    {
+      char order = h.descr[0];
+      if (order == mine[0] || order == '=' || order == '|')
+        return false;
+      if (order == '<' || order == '>')
+        return true;
+    }
+    throw runtime_error("NPY dtype " + h.descr + " does not match " + mine);
+  }
+
+  // длина преамбулы (магия, версия, длина словаря) по её первым 12 байтам
+  static size_t preamble(const unsigned char* p, size_t n, size_t& dictLen)
+  {
+    if (n < 10 || memcmp(p, "\x93NUMPY", 6) != 0)
+      throw runtime_error("bad NPY magic");
+    if (p[6] == 1)
+    {
+      dictLen = (size_t)p[8] | (size_t)p[9] << 8;
+      return 10;
+    }
+    if ((p[6] == 2 || p[6] == 3) && n >= 12)
+    {
+      dictLen = (size_t)p[8] | (size_t)p[9] << 8 | (size_t)p[10] << 16 | (size_t)p[11] << 24;
+      return 12;
+    }
+    throw runtime_error("unsupported NPY version");
+  }
+  static THeader parseDict(const string& d)
+  {
+    THeader h;
+    auto value = [&d](const char* key) {
+      size_t k = d.find(key);
+      if (k == string::npos || (k = d.find(':', k)) == string::npos)
+        throw runtime_error(string("NPY header has no ") + key);
+      if ((k = d.find_first_not_of(' ', k + 1)) == string::npos)
+        throw runtime_error(string("bad NPY ") + key);
+      return k;
+    };
+    size_t k = value("'descr'");
+    size_t e = d.find(d[k], k + 1);
+    if (e == string::npos || (d[k] != '\'' && d[k] != '"'))
+      throw runtime_error("bad NPY descr");
+    h.descr = d.substr(k + 1, e - k - 1);
+    k = value("'fortran_order'");
+    h.fortranOrder = d.compare(k, 4, "True") == 0;
+    k = value("'shape'");
+    if (d[k] != '(' || (e = d.find(')', k)) == string::npos)
+      throw runtime_error("bad NPY shape");
+    for (k++; k < e;)
+    {
+      k = d.find_first_not_of(", ", k);
+      if (k >= e)
+        break;
+      size_t used = 0;
+      h.shape.push_back((size_t)stoull(d.substr(k, e - k), &used));
+      k += used;
+    }
+    return h;
+  }
+  static THeader readHeader(istream& istr)
+  {
+    unsigned char pre[12];
+    size_t n = 10;
+    istr.read((char*)pre, 10);
+    if (istr && pre[6] >= 2)
+    {
+      istr.read((char*)pre + 10, 2);
+      n = 12;
+    }
+    if (!istr)
+      throw runtime_error("truncated NPY header");
+    size_t dictLen;
+    preamble(pre, n, dictLen);
+    string d(dictLen, '\0');
+    istr.read(&d[0], (streamsize)dictLen);
+    if (!istr)
+      throw runtime_error("truncated NPY header");
+    return parseDict(d);
+  }
+  // преамбула и словарь версии 1.0, выровненные на 64 байта
+  static string makeHeader(const string& dtype, bool fortranOrder, const vector<size_t>& shape)
+  {
+    string d = "{'descr': '" + dtype + "', 'fortran_order': " + (fortranOrder ? "True" : "False") + ", 'shape': (";
+    for (size_t k = 0; k < shape.size(); k++)
+      d += to_string(shape[k]) + (shape.size() == 1 ? "," : k + 1 < shape.size() ? ", " : "");
+    d += "), }";
+    d.append(63 - (10 + d.size()) % 64, ' ');
+    d += '\n';
+    string pre = "\x93NUMPY\x01";
+    pre += '\0';
+    pre += (char)(d.size() & 0xFF);
+    pre += (char)(d.size() >> 8);
+    return pre + d;
+  }
+
+  template<typename T>
+  static void swapBytes(T* p, size_t n) noexcept
+  {
+    for (size_t i = 0; i < n; i++)
+    {
+      unsigned char* b = reinterpret_cast<unsigned char*>(p + i);
+      reverse(b, b + sizeof(T));
+    }
+  }
+  template<typename T>
+  static void readData(istream& istr, const THeader& h, T* dst)
+  {
+    bool swap = swapped<T>(h);
+    istr.read((char*)dst, (streamsize)h.bytes(sizeof(T)));
+    if (!istr)
+      throw runtime_error("truncated NPY data");
+    if (swap)
+      swapBytes(dst, h.count());
+  }
+
+  // байты элементов в порядке файла: непрерывные - одним куском, иначе по строкам
+  template<typename T, typename F>
+  static void chunks(TMatrixView<const T> m, F f)
+  {
+    if (m.isContiguous())
+    {
+      f(m.data(), m.rows() * m.cols() * sizeof(T));
+      return;
+    }
+    TDynamicVector<T> row(m.cols());
+    for (size_t i = 0; i < m.rows(); i++)
+    {
+      row.view().assign(m[i]);
+      f(row.data(), m.cols() * sizeof(T));
+    }
+  }
+  template<typename T, typename F>
+  static void chunks(TVectorView<const T> v, F f)
+  {
+    if (v.stride() == 1)
+      f(v.data(), v.size() * sizeof(T));
+    else
+    {
+      TDynamicVector<T> copy(v);
+      f(copy.data(), v.size() * sizeof(T));
+    }
+  }
+  template<typename T>
+  static string header(TMatrixView<const T> m)
+  {
+    return makeHeader(descr<T>(), m.isContiguous() && m.layout() == TMatrixLayout::ColMajor, { m.rows(), m.cols() });
+  }
+  template<typename T>
+  static string header(TVectorView<const T> v)
+  {
+    return makeHeader(descr<T>(), false, { v.size() });
+  }
+
+  template<typename T>
+  static TDynamicMatrix<T> readMatrix(istream& istr)
+  {
+    THeader h = readHeader(istr);
+    if (h.shape.size() != 2)
+      throw runtime_error("NPY array is not 2-D");
+    TDynamicMatrix<T> res(h.shape[0], h.shape[1], h.fortranOrder ? TMatrixLayout::ColMajor : TMatrixLayout::RowMajor);
+    readData(istr, h, res.view().data());
+    return res;
+  }
+  // одномерный массив или матрица из одной строки/столбца
+  template<typename T>
+  static TDynamicVector<T> readVector(istream& istr)
+  {
+    THeader h = readHeader(istr);
+    if (h.shape.size() != 1 && !(h.shape.size() == 2 && (h.shape[0] == 1 || h.shape[1] == 1)))
+      throw runtime_error("NPY array is not a vector");
+    TDynamicVector<T> res(h.count());
+    readData(istr, h, res.data());
+    return res;
+  }
+  template<typename T>
+  static void write(ostream& ostr, TMatrixView<const T> m)
+  {
+    string hdr = header(m);
+    ostr.write(hdr.data(), (streamsize)hdr.size());
+    chunks(m, [&ostr](const void* p, size_t n) { ostr.write((const char*)p, (streamsize)n); });
+  }
+  template<typename T>
+  static void write(ostream& ostr, TVectorView<const T> v)
+  {
+    string hdr = header(v);
+    ostr.write(hdr.data(), (streamsize)hdr.size());
+    chunks(v, [&ostr](const void* p, size_t n) { ostr.write((const char*)p, (streamsize)n); });
+  }
+
+  template<typename T>
+  static TDynamicMatrix<T> loadMatrix(const string& path)
+  {
+    ifstream f(path, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    return readMatrix<T>(f);
+  }
+  template<typename T>
+  static TDynamicVector<T> loadVector(const string& path)
+  {
+    ifstream f(path, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    return readVector<T>(f);
+  }
+  template<typename T, typename V>
+  static void save(const string& path, V a)
+  {
+    ofstream f(path, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    write<T>(f, a);
+    f.flush();
+    if (!f)
+      throw runtime_error("cannot write " + path);
+  }
+};
+
+// Файл .npy, отображённый в память только для чтения:
+// matrix()/vector() - представления прямо над страницами файла, без копирования;
+// если порядок байт другой (или mmap недоступен), элементы читаются в свой буфер
+template<typename T>
+class TNpyMap
+{
+  TNpy::THeader h;
+  void* base = nullptr;
+  size_t len = 0;
+  std::vector<T> own;
+  const T* pData = nullptr;
+public:
+  explicit TNpyMap(const string& path)
+  {
+#if defined(__linux__)
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+      throw runtime_error("cannot open " + path);
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+      len = (size_t)st.st_size;
+      base = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (base == MAP_FAILED)
+      base = nullptr;
+    if (base)
+    {
+      // деструктор не вызовется, если конструктор бросит исключение
+      try
+      {
+        const unsigned char* p = static_cast<const unsigned char*>(base);
+        size_t dictLen, off = TNpy::preamble(p, len, dictLen);
+        if (off + dictLen > len)
+          throw runtime_error("truncated NPY header");
+        h = TNpy::parseDict(string((const char*)p + off, dictLen));
+        off += dictLen;
+        if (len - off < h.bytes(sizeof(T)))
+          throw runtime_error("truncated NPY data");
+        if (!TNpy::swapped<T>(h) && off % alignof(T) == 0)
+        {
+          pData = reinterpret_cast<const T*>(p + off);
+          return;
+        }
+      }
+      catch (...)
+      {
+        munmap(base, len);
+        throw;
+      }
+      munmap(base, len);
+      base = nullptr;
+    }
+#endif
+    ifstream f(path, ios::binary);
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    h = TNpy::readHeader(f);
+    own.resize(h.bytes(sizeof(T)) / sizeof(T));
+    TNpy::readData(f, h, own.data());
+    pData = own.data();
+  }
+  TNpyMap(const TNpyMap&) = delete;
+  TNpyMap& operator=(const TNpyMap&) = delete;
+  ~TNpyMap()
+  {
+#if defined(__linux__)
+    if (base)
+      munmap(base, len);
+#endif
+  }
+
+  const TNpy::THeader& header() const noexcept { return h; }
+  // элементы лежат в отображённом файле (а не в своём буфере)
+  bool mapped() const noexcept { return base != nullptr; }
+
+  TMatrixView<const T> matrix() const
+  {
+    if (h.shape.size() != 2)
+      throw runtime_error("NPY array is not 2-D");
+    size_t r = h.shape[0], c = h.shape[1];
+    return h.fortranOrder ? TMatrixView<const T>(pData, r, c, 1, (ptrdiff_t)r) : TMatrixView<const T>(pData, r, c, (ptrdiff_t)c);
+  }
+  TVectorView<const T> vector() const
+  {
+    return TVectorView<const T>(pData, h.count());
+  }
+};
+
+// .npz - zip-архив из файлов <имя>.npy (как у numpy.savez);
+// поддерживаются несжатые элементы (method 0) и zip64
+class TNpz
+{
+  struct TMember
+  {
+    string name;
+    uint16_t method;
+    uint64_t offset; // локального заголовка
+  };
+  ifstream f;
+  std::vector<TMember> members;
+
+  static uint64_t le(const unsigned char* p, int n) noexcept
+  {
+    uint64_t x = 0;
+    for (int k = n - 1; k >= 0; k--)
+      x = x << 8 | p[k];
+    return x;
+  }
+  void readAt(uint64_t pos, void* dst, size_t n)
+  {
+    f.seekg((streamoff)pos);
+    f.read((char*)dst, (streamsize)n);
+    if (!f)
+      throw runtime_error("truncated NPZ archive");
+  }
+  // позиция файла .npy элемента name (по локальному заголовку)
+  void seek(const string& name)
+  {
+    for (const TMember& m : members)
+      if (m.name == name + ".npy")
+      {
+        if (m.method != 0)
+          throw runtime_error("compressed NPZ member " + name + " is not supported");
+        unsigned char lh[30];
+        readAt(m.offset, lh, sizeof(lh));
+        if (le(lh, 4) != 0x04034b50)
+          throw runtime_error("bad NPZ local header");
+        f.seekg((streamoff)(m.offset + 30 + le(lh + 26, 2) + le(lh + 28, 2)));
+        return;
+      }
+    throw out_of_range("no NPZ member " + name);
+  }
+public:
+  explicit TNpz(const string& path) : f(path, ios::binary)
+  {
+    if (!f)
+      throw runtime_error("cannot open " + path);
+    f.seekg(0, ios::end);
+    uint64_t size = (uint64_t)f.tellg();
+    // конец центрального каталога - в последних 22 + 65535 байтах
+    size_t tail = (size_t)min<uint64_t>(size, 22 + 65535);
+    std::vector<unsigned char> t(tail);
+    readAt(size - tail, t.data(), tail);
+    size_t e = tail < 22 ? 0 : tail - 22 + 1;
+    while (e > 0 && le(&t[e - 1], 4) != 0x06054b50)
+      e--;
+    if (e == 0)
+      throw runtime_error("bad NPZ archive");
+    const unsigned char* eocd = &t[e - 1];
+    uint64_t count = le(eocd + 10, 2), cdOffset = le(eocd + 16, 4);
+    uint64_t eocdPos = size - tail + (e - 1);
+    if ((count == 0xFFFF || cdOffset == 0xFFFFFFFF) && eocdPos >= 20)
+    {
+      unsigned char loc[20], z[56];
+      readAt(eocdPos - 20, loc, sizeof(loc));
+      if (le(loc, 4) == 0x07064b50)
+      {
+        readAt(le(loc + 8, 8), z, sizeof(z));
+        if (le(z, 4) != 0x06064b50)
+          throw runtime_error("bad NPZ zip64 directory");
+        count = le(z + 32, 8);
+        cdOffset = le(z + 48, 8);
+      }
+    }
+    uint64_t pos = cdOffset;
+    for (uint64_t k = 0; k < count; k++)
+    {
+      unsigned char c[46];
+      readAt(pos, c, sizeof(c));
+      if (le(c, 4) != 0x02014b50)
+        throw runtime_error("bad NPZ central directory");
+      size_t nameLen = (size_t)le(c + 28, 2), extraLen = (size_t)le(c + 30, 2), commentLen = (size_t)le(c + 32, 2);
+      std::vector<unsigned char> rest(nameLen + extraLen);
+      if (!rest.empty())
+        f.read((char*)rest.data(), (streamsize)rest.size());
+      TMember m;
+      m.name.assign((const char*)rest.data(), nameLen);
+      m.method = (uint16_t)le(c + 10, 2);
+      m.offset = le(c + 42, 4);
+      // zip64: переполненные поля (размеры, смещение) - по порядку в дополнительном поле 0x0001
+      for (size_t x = nameLen; x + 4 <= rest.size();)
+      {
+        size_t id = (size_t)le(&rest[x], 2), n = (size_t)le(&rest[x + 2], 2);
+        if (id == 1)
+        {
+          size_t y = x + 4;
+          for (int field : { 24, 20 })
+            if (le(c + field, 4) == 0xFFFFFFFF)
+              y += 8;
+          if (m.offset == 0xFFFFFFFF && y + 8 <= x + 4 + n)
+            m.offset = le(&rest[y], 8);
+        }
+        x += 4 + n;
+      }
+      members.push_back(m);
+      pos += 46 + nameLen + extraLen + commentLen;
+    }
+  }
+
+  // имена массивов (без ".npy")
+  std::vector<string> names() const
+  {
+    std::vector<string> res;
+    for (const TMember& m : members)
+      if (m.name.size() > 4 && m.name.compare(m.name.size() - 4, 4, ".npy") == 0)
+        res.push_back(m.name.substr(0, m.name.size() - 4));
+    return res;
+  }
+  bool contains(const string& name) const
+  {
+    for (const TMember& m : members)
+      if (m.name == name + ".npy")
+        return true;
+    return false;
+  }
+  template<typename T>
+  TDynamicMatrix<T> readMatrix(const string& name)
+  {
+    seek(name);
+    return TNpy::readMatrix<T>(f);
+  }
+  template<typename T>
+  TDynamicVector<T> readVector(const string& name)
+  {
+    seek(name);
+    return TNpy::readVector<T>(f);
+  }
+};
+
+// Запись .npz без сжатия: каждый массив - один проход для CRC32 и один для записи,
+// без промежуточной копии файла .npy; при необходимости - zip64
+class TNpzWriter
+{
+  struct TEntry
+  {
+    string name;
+    uint32_t crc;
+    uint64_t size, offset;
+  };
+  ofstream f;
+  std::vector<TEntry> entries;
+  uint64_t pos = 0;
+  bool closed = false;
+
+  void put(const void* p, size_t n)
+  {
+    f.write((const char*)p, (streamsize)n);
+    pos += n;
+  }
+  void le(uint64_t x, int n)
+  {
+    unsigned char b[8];
+    for (int k = 0; k < n; k++)
+      b[k] = (unsigned char)(x >> (8 * k));
+    put(b, (size_t)n);
+  }
+
+  template<typename A>
+  void addArray(const string& name, A a)
+  {
+    if (closed)
+      throw runtime_error("NPZ archive is closed");
+    string hdr = TNpy::header(a);
+    TCrc32 crc;
+    crc.update(hdr.data(), hdr.size());
+    uint64_t size = hdr.size();
+    TNpy::chunks(a, [&](const void* p, size_t n) {
+      crc.update(p, n);
+      size += n;
+    });
+    TEntry e = { name + ".npy", crc.digest(), size, pos };
+    bool zip64 = size >= 0xFFFFFFFF;
+    le(0x04034b50, 4);
+    le(zip64 ? 45 : 20, 2); // версия для распаковки
+    le(0, 2); // флаги
+    le(0, 2); // без сжатия
+    le(0, 2); // время
+    le(0x21, 2); // дата: 1980-01-01
+    le(e.crc, 4);
+    le(zip64 ? 0xFFFFFFFF : size, 4);
+    le(zip64 ? 0xFFFFFFFF : size, 4);
+    le(e.name.size(), 2);
+    le(zip64 ? 20 : 0, 2);
+    put(e.name.data(), e.name.size());
+    if (zip64)
+    {
+      le(1, 2);
+      le(16, 2);
+      le(size, 8);
+      le(size, 8);
+    }
+    put(hdr.data(), hdr.size());
+    TNpy::chunks(a, [this](const void* p, size_t n) { put(p, n); });
+    if (!f)
+      throw runtime_error("cannot write NPZ member " + name);
+    entries.push_back(e);
+  }
+public:
+  explicit TNpzWriter(const string& path) : f(path, ios::binary)
+  {
+    if (!f)
+      throw runtime_error("cannot open " + path);
+  }
+  TNpzWriter(const TNpzWriter&) = delete;
+  TNpzWriter& operator=(const TNpzWriter&) = delete;
+  ~TNpzWriter()
+  {
+    if (!closed)
+      try
+      {
+        close();
+      }
+      catch (...)
+      {
+      }
+  }
+
+  template<typename T>
+  void add(const string& name, TMatrixView<const T> m) { addArray(name, m); }
+  template<typename T>
+  void add(const string& name, TVectorView<const T> v) { addArray(name, v); }
+
+  // центральный каталог и конец архива
+  void close()
+  {
+    if (closed)
+      return;
+    closed = true;
+    uint64_t cdOffset = pos;
+    for (const TEntry& e : entries)
+    {
+      bool bigSize = e.size >= 0xFFFFFFFF, bigOffset = e.offset >= 0xFFFFFFFF;
+      size_t extra = (bigSize ? 16 : 0) + (bigOffset ? 8 : 0);
+      le(0x02014b50, 4);
+      le(45, 2); // версия архиватора
+      le(extra ? 45 : 20, 2);
+      le(0, 2);
+      le(0, 2);
+      le(0, 2);
+      le(0x21, 2);
+      le(e.crc, 4);
+      le(bigSize ? 0xFFFFFFFF : e.size, 4);
+      le(bigSize ? 0xFFFFFFFF : e.size, 4);
+      le(e.name.size(), 2);
+      le(extra ? extra + 4 : 0, 2);
+      le(0, 2); // комментарий
+      le(0, 2); // диск
+      le(0, 2); // внутренние атрибуты
+      le(0, 4); // внешние атрибуты
+      le(bigOffset ? 0xFFFFFFFF : e.offset, 4);
+      put(e.name.data(), e.name.size());
+      if (extra)
+      {
+        le(1, 2);
+        le(extra, 2);
+        if (bigSize)
+        {
+          le(e.size, 8);
+          le(e.size, 8);
+        }
+        if (bigOffset)
+          le(e.offset, 8);
+      }
+    }
+    uint64_t cdSize = pos - cdOffset, count = entries.size();
+    if (count >= 0xFFFF || cdOffset >= 0xFFFFFFFF || cdSize >= 0xFFFFFFFF)
+    {
+      uint64_t z = pos;
+      le(0x06064b50, 4);
+      le(44, 8);
+      le(45, 2);
+      le(45, 2);
+      le(0, 4);
+      le(0, 4);
+      le(count, 8);
+      le(count, 8);
+      le(cdSize, 8);
+      le(cdOffset, 8);
+      le(0x07064b50, 4);
+      le(0, 4);
+      le(z, 8);
+      le(1, 4);
+    }
+    le(0x06054b50, 4);
+    le(0, 2);
+    le(0, 2);
+    le(min<uint64_t>(count, 0xFFFF), 2);
+    le(min<uint64_t>(count, 0xFFFF), 2);
+    le(min<uint64_t>(cdSize, 0xFFFFFFFF), 4);
+    le(min<uint64_t>(cdOffset, 0xFFFFFFFF), 4);
+    le(0, 2);
+    f.close();
+    if (!f)
+      throw runtime_error("cannot write NPZ archive");
+  }
+};
+
+#endif
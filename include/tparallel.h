@@ -0,0 +1,248 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Параллельное выполнение ядер векторов и матриц
+//
+
+#ifndef __TParallel_H__
+#define __TParallel_H__
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Пул потоков с перехватом задач (work stealing) -
+// один на процесс, запускается при первом обращении; у каждого потока своя очередь:
+// свои задачи берутся с конца (LIFO), чужие перехватываются с начала,
+// задачи из внешних потоков попадают в общую очередь
+class TThreadPool
+{
+  struct TQueue
+  {
+    std::mutex m;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  std::vector<std::unique_ptr<TQueue>> queues; // 0 - общая, w + 1 - потока w
+  std::vector<std::thread> workers;
+  std::mutex sleepMutex;
+  std::condition_variable sleepCv;
+  long pending = 0; // под sleepMutex
+  bool stop = false;
+
+  // номер очереди текущего потока в этом пуле; 0 - внешний поток
+  static size_t& self() noexcept
+  {
+    static thread_local size_t q = 0;
+    return q;
+  }
+
+  explicit TThreadPool(size_t n)
+  {
+    for (size_t i = 0; i <= n; i++)
+      queues.push_back(std::make_unique<TQueue>());
+    workers.reserve(n);
+    for (size_t w = 0; w < n; w++)
+      workers.emplace_back([this, w] { loop(w + 1); });
+  }
+
+  void loop(size_t q)
+  {
+    self() = q;
+    for (;;)
+    {
+      if (runOne())
+        continue;
+      std::unique_lock<std::mutex> lock(sleepMutex);
+      sleepCv.wait(lock, [this] { return stop || pending > 0; });
+      if (stop && pending <= 0)
+        return;
+    }
+  }
+
+  bool pop(size_t q, bool back, std::function<void()>& task)
+  {
+    TQueue& queue = *queues[q];
+    std::lock_guard<std::mutex> lock(queue.m);
+    if (queue.tasks.empty())
+      return false;
+    if (back)
+    {
+      task = std::move(queue.tasks.back());
+      queue.tasks.pop_back();
+    }
+    else
+    {
+      task = std::move(queue.tasks.front());
+      queue.tasks.pop_front();
+    }
+    return true;
+  }
+public:
+  TThreadPool(const TThreadPool&) = delete;
+  TThreadPool& operator=(const TThreadPool&) = delete;
+  ~TThreadPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      stop = true;
+    }
+    sleepCv.notify_all();
+    for (std::thread& t : workers)
+      t.join();
+  }
+
+  // по одному рабочему потоку на аппаратный, кроме вызывающего, но не меньше одного
+  // (на одном ядре пул используется, только если TParallel::threads > 1)
+  static TThreadPool& instance()
+  {
+    static TThreadPool pool(std::max(std::thread::hardware_concurrency(), 2u) - 1);
+    return pool;
+  }
+
+  size_t size() const noexcept { return workers.size(); }
+  bool isWorker() const noexcept { return self() != 0; }
+
+  void submit(std::function<void()> task)
+  {
+    {
+      TQueue& queue = *queues[self()];
+      std::lock_guard<std::mutex> lock(queue.m);
+      queue.tasks.push_back(std::move(task));
+    }
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      pending++;
+    }
+    sleepCv.notify_one();
+  }
+
+  // выполнить одну задачу: свою последнюю или перехваченную первую чужую
+  bool runOne()
+  {
+    std::function<void()> task;
+    size_t q = self(), n = queues.size();
+    bool found = q != 0 && pop(q, true, task);
+    for (size_t i = 1; !found && i <= n; i++)
+      found = pop((q + i) % n, false, task);
+    if (!found)
+      return false;
+    {
+      std::lock_guard<std::mutex> lock(sleepMutex);
+      pending--;
+    }
+    task();
+    return true;
+  }
+};
+
+struct TParallel
+{
+  // число потоков для ядер; 0 - по числу аппаратных потоков
+  static inline size_t threads = 0;
+  // минимальное число элементов на поток в поэлементных ядрах
+  static constexpr size_t GRAIN = 1 << 15;
+
+  static size_t concurrency() noexcept
+  {
+    size_t t = threads ? threads : (size_t)std::thread::hardware_concurrency();
+    return t ? t : 1;
+  }
+
+  // f(first, last) на непересекающихся отрезках [0, n) длиной не меньше grain
+  template<typename F>
+  static void forRange(size_t n, size_t grain, F f)
+  {
+    if (n == 0)
+      return;
+    grain = std::max<size_t>(grain, 1);
+    size_t workers = std::min(concurrency(), (n + grain - 1) / grain);
+    if (workers <= 1)
+    {
+      f((size_t)0, n);
+      return;
+    }
+    size_t chunk = (n + workers - 1) / workers;
+    run(workers, [&](size_t w) {
+      size_t first = w * chunk, last = std::min(n, first + chunk);
+      if (first < last)
+        f(first, last);
+    });
+  }
+
+  // f(i) для каждого i из [0, count); задачи раздаются динамически
+  template<typename F>
+  static void forEach(size_t count, F f)
+  {
+    size_t workers = std::min(concurrency(), count);
+    if (workers <= 1)
+    {
+      for (size_t i = 0; i < count; i++)
+        f(i);
+      return;
+    }
+    std::atomic<size_t> next(0);
+    run(workers, [&](size_t) {
+      for (size_t i = next++; i < count; i = next++)
+        f(i);
+    });
+  }
+
+private:
+  // body(w) для w из [0, workers): w = 0 - в вызывающем потоке, остальные - задачи пула;
+  // пока задачи не завершены, вызывающий выполняет задачи пула сам, поэтому
+  // вложенные вызовы (в том числе из потоков пула) не создают новых потоков;
+  // первое исключение пробрасывается
+  template<typename F>
+  static void run(size_t workers, F body)
+  {
+    std::exception_ptr err;
+    std::mutex m;
+    std::condition_variable done;
+    size_t left = workers - 1; // под m
+    auto guarded = [&](size_t w) {
+      try
+      {
+        body(w);
+      }
+      catch (...)
+      {
+        std::lock_guard<std::mutex> lock(m);
+        if (!err)
+          err = std::current_exception();
+      }
+    };
+    TThreadPool& pool = TThreadPool::instance();
+    for (size_t w = 1; w < workers; w++)
+      pool.submit([&, w] {
+        guarded(w);
+        std::lock_guard<std::mutex> lock(m);
+        if (--left == 0)
+          done.notify_all();
+      });
+    guarded(0);
+    for (;;)
+    {
+      {
+        std::unique_lock<std::mutex> lock(m);
+        if (left == 0)
+          break;
+      }
+      if (pool.runOne())
+        continue;
+      std::unique_lock<std::mutex> lock(m);
+      done.wait_for(lock, std::chrono::microseconds(100), [&] { return left == 0; });
+    }
+    if (err)
+      std::rethrow_exception(err);
+  }
+};
+
+#endif
@@ -0,0 +1,97 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Разреженная матрица в координатном формате
+//
+
+#ifndef __TSparse_H__
+#define __TSparse_H__
+
+#include <algorithm>
+#include <vector>
+#include "tmatrix.h"
+
+// Разреженная матрица -
+// ненулевые элементы хранятся списком троек (строка, столбец, значение) в порядке добавления;
+// повторные элементы с одними координатами суммируются
+template<typename T>
+class TSparseMatrix
+{
+public:
+  struct TEntry
+  {
+    size_t row, col;
+    T value;
+  };
+private:
+  size_t nRows, nCols;
+  vector<TEntry> entries;
+public:
+  TSparseMatrix(size_t rows, size_t cols) : nRows(rows), nCols(cols)
+  {
+    if (rows == 0 || cols == 0)
+      throw out_of_range("Matrix size should be greater than zero");
+  }
+  static TSparseMatrix fromDense(TMatrixView<const T> m)
+  {
+    TSparseMatrix res(m.rows(), m.cols());
+    for (size_t i = 0; i < m.rows(); i++)
+      for (size_t j = 0; j < m.cols(); j++)
+        if (m(i, j) != T())
+          res.entries.push_back({ i, j, m(i, j) });
+    return res;
+  }
+
+  size_t rows() const noexcept { return nRows; }
+  size_t cols() const noexcept { return nCols; }
+  size_t nnz() const noexcept { return entries.size(); }
+  const TEntry& entry(size_t k) const { return entries.at(k); }
+  typename vector<TEntry>::const_iterator begin() const noexcept { return entries.begin(); }
+  typename vector<TEntry>::const_iterator end() const noexcept { return entries.end(); }
+
+  void reserve(size_t n) { entries.reserve(n); }
+  void add(size_t i, size_t j, const T& x)
+  {
+    if (i >= nRows || j >= nCols)
+      throw out_of_range("bad index");
+    entries.push_back({ i, j, x });
+  }
+  // упорядочить по строкам и слить повторы
+  void compress()
+  {
+    sort(entries.begin(), entries.end(), [](const TEntry& a, const TEntry& b) {
+      return a.row != b.row ? a.row < b.row : a.col < b.col;
+    });
+    size_t k = 0;
+    for (size_t i = 0; i < entries.size(); i++)
+      if (k && entries[k - 1].row == entries[i].row && entries[k - 1].col == entries[i].col)
+        entries[k - 1].value = entries[k - 1].value + entries[i].value;
+      else
+        entries[k++] = entries[i];
+    entries.resize(k);
+  }
+
+  TDynamicMatrix<T> toDense(TMatrixLayout layout = TMatrixLayout::RowMajor) const
+  {
+    TDynamicMatrix<T> res(nRows, nCols, layout);
+    TMatrixView<T> m = res.view();
+    for (const TEntry& e : entries)
+      m(e.row, e.col) = m(e.row, e.col) + e.value;
+    return res;
+  }
+
+  // матрично-векторное произведение
+  TDynamicVector<T> operator*(TVectorView<const T> v) const
+  {
+    if (v.size() != nCols)
+      throw out_of_range("bad size");
+    vector<TAccumulatorT<T>> acc(nRows, TAccumulatorT<T>());
+    for (const TEntry& e : entries)
+      acc[e.row] = acc[e.row] + (TAccumulatorT<T>)e.value * (TAccumulatorT<T>)v[e.col];
+    TDynamicVector<T> res(nRows);
+    for (size_t i = 0; i < nRows; i++)
+      res[i] = (T)acc[i];
+    return res;
+  }
+};
+
+#endif
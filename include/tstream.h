@@ -0,0 +1,143 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Конвейерные вычисления над матрицами, поступающими полосами строк
+//
+
+#ifndef __TStream_H__
+#define __TStream_H__
+
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "tmatrix.h"
+
+// Конвейер по полосам строк -
+// матрица не хранится целиком: поток чтения заполняет следующую полосу, пока
+// вычисляется произведение предыдущей (depth буферов, по умолчанию двойная буферизация),
+// результат отдаётся приёмнику по частям в порядке строк.
+// source(panel) заполняет первые строки полосы panel (panelRows x cols, по строкам)
+// и возвращает их число, 0 - конец матрицы; вызывается из отдельного потока.
+// sink(first, y) получает строки результата [first, first + y.size())
+struct TPipeline
+{
+  template<typename T, typename Source, typename Sink>
+  static size_t matVec(TVectorView<const T> x, size_t panelRows, Source source, Sink sink, size_t depth = 2)
+  {
+    if (panelRows == 0 || depth < 2)
+      throw out_of_range("bad pipeline size");
+    size_t cols = x.size();
+    // полосы - плоские буферы: ширина матрицы не ограничена MAX_MATRIX_SIZE
+    vector<TDynamicVector<T>> panels;
+    vector<T*> base(depth);
+    panels.reserve(depth);
+    for (size_t k = 0; k < depth; k++)
+    {
+      panels.emplace_back(panelRows * cols);
+      base[k] = panels[k].data();
+    }
+
+    mutex m;
+    condition_variable cv;
+    deque<size_t> free; // буферы, которые можно заполнять
+    deque<pair<size_t, size_t>> ready; // (буфер, строк); 0 строк - конец
+    bool stop = false;
+    exception_ptr err;
+    for (size_t k = 0; k < depth; k++)
+      free.push_back(k);
+
+    thread reader([&] {
+      for (;;)
+      {
+        size_t s;
+        {
+          unique_lock<mutex> lock(m);
+          cv.wait(lock, [&] { return stop || !free.empty(); });
+          if (stop)
+            return;
+          s = free.front();
+          free.pop_front();
+        }
+        size_t rows = 0;
+        try
+        {
+          rows = source(TMatrixView<T>(base[s], panelRows, cols, (ptrdiff_t)cols));
+          if (rows > panelRows)
+            throw out_of_range("bad panel rows");
+        }
+        catch (...)
+        {
+          lock_guard<mutex> lock(m);
+          err = current_exception();
+          rows = 0;
+        }
+        {
+          lock_guard<mutex> lock(m);
+          ready.emplace_back(s, rows);
+        }
+        cv.notify_all();
+        if (rows == 0)
+          return;
+      }
+    });
+
+    size_t first = 0;
+    try
+    {
+      for (;;)
+      {
+        pair<size_t, size_t> p;
+        {
+          unique_lock<mutex> lock(m);
+          cv.wait(lock, [&] { return !ready.empty(); });
+          p = ready.front();
+          ready.pop_front();
+        }
+        if (p.second == 0)
+          break;
+        TMatrixView<const T> panel(base[p.first], p.second, cols, (ptrdiff_t)cols);
+        TDynamicVector<T> y = panel * x;
+        sink(first, TVectorView<const T>(y));
+        first += p.second;
+        {
+          lock_guard<mutex> lock(m);
+          free.push_back(p.first);
+        }
+        cv.notify_all();
+      }
+    }
+    catch (...)
+    {
+      {
+        lock_guard<mutex> lock(m);
+        stop = true;
+      }
+      cv.notify_all();
+      reader.join();
+      throw;
+    }
+    reader.join();
+    if (err)
+      rethrow_exception(err);
+    return first;
+  }
+
+  // источник из двоичного потока: строки по cols элементов T подряд, без заголовка
+  template<typename T>
+  static auto binaryRows(istream& istr)
+  {
+    return [&istr](TMatrixView<T> panel) -> size_t {
+      size_t rowBytes = panel.cols() * sizeof(T);
+      istr.read((char*)panel.data(), (streamsize)(panel.rows() * rowBytes));
+      size_t got = (size_t)istr.gcount();
+      if (got % rowBytes)
+        throw runtime_error("truncated matrix row");
+      return got / rowBytes;
+    };
+  }
+};
+
+#endif
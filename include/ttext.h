@@ -0,0 +1,349 @@
+﻿// ННГУ, ИИТММ, Курс "Алгоритмы и структуры данных"
+//
+// Быстрый текстовый ввод/вывод чисел
+//
+
+#ifndef __TText_H__
+#define __TText_H__
+
+#include <atomic>
+#include <charconv>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <locale>
+#include <string>
+#include <type_traits>
+#include <vector>
+#include "tparallel.h"
+
+// Числа форматируются std::to_chars и разбираются std::from_chars блоками,
+// минуя локаль и форматирование iostream; вывод не сбрасывается после строк.
+// Блоки обрабатываются параллельно, в потоке - по порядку. Быстрый путь включается,
+// только если результат совпадёт с iostream: классическая локаль, без ширины,
+// showpos/showpoint/uppercase и шестнадцатеричного вывода
+struct TTextIO
+{
+  // элементов в одном блоке форматирования/разбора
+  static constexpr size_t BLOCK = 1 << 14;
+  static constexpr std::streamsize MAX_PRECISION = 100;
+
+  template<typename T>
+  static constexpr bool supported = std::is_arithmetic<T>::value && !std::is_same<T, bool>::value &&
+    !std::is_same<T, char>::value && !std::is_same<T, signed char>::value && !std::is_same<T, unsigned char>::value;
+
+  template<typename T>
+  static bool fastOutput(const std::ostream& ostr)
+  {
+    if (!supported<T> || ostr.width() != 0 || ostr.getloc() != std::locale::classic())
+      return false;
+    std::ios_base::fmtflags f = ostr.flags();
+    if (f & (std::ios_base::showpos | std::ios_base::showpoint | std::ios_base::uppercase | std::ios_base::showbase))
+      return false;
+    if (std::is_integral<T>::value)
+      return (f & std::ios_base::basefield) == std::ios_base::dec || (f & std::ios_base::basefield) == 0;
+    return (f & std::ios_base::floatfield) != std::ios_base::floatfield && ostr.precision() <= MAX_PRECISION;
+  }
+  template<typename T>
+  static bool fastInput(const std::istream& istr)
+  {
+    if (!supported<T> || istr.getloc() != std::locale::classic() || !(istr.flags() & std::ios_base::skipws))
+      return false;
+    std::ios_base::fmtflags base = istr.flags() & std::ios_base::basefield;
+    return !std::is_integral<T>::value || base == std::ios_base::dec;
+  }
+
+  // count элементов get(k) через пробел; при rowLen > 0 после каждых rowLen элементов - '\n'
+  template<typename T, typename Get>
+  static void write(std::ostream& ostr, size_t count, size_t rowLen, Get get)
+  {
+    std::ostream::sentry ok(ostr);
+    if (!ok)
+      return;
+    std::chars_format fmt = std::chars_format::general;
+    if ((ostr.flags() & std::ios_base::floatfield) == std::ios_base::fixed)
+      fmt = std::chars_format::fixed;
+    else if ((ostr.flags() & std::ios_base::floatfield) == std::ios_base::scientific)
+      fmt = std::chars_format::scientific;
+    int precision = (int)ostr.precision();
+    size_t blocks = (count + BLOCK - 1) / BLOCK;
+    size_t batch = 2 * TParallel::concurrency();
+    std::vector<std::string> bufs(std::min(batch, blocks));
+    std::atomic<bool> failed(false);
+    for (size_t b0 = 0; b0 < blocks; b0 += batch)
+    {
+      size_t nb = std::min(batch, blocks - b0);
+      TParallel::forEach(nb, [&](size_t t) {
+        std::string& s = bufs[t];
+        s.clear();
+        // худший случай - fixed: все цифры целой части, точка и precision знаков;
+        // в конце - место под ' ' и '\n'
+        char tmp[std::numeric_limits<T>::max_exponent10 + MAX_PRECISION + 40];
+        char* end = tmp + sizeof(tmp) - 2;
+        size_t first = (b0 + t) * BLOCK, last = std::min(count, first + BLOCK);
+        for (size_t k = first; k < last; k++)
+        {
+          std::to_chars_result r;
+          if constexpr (std::is_floating_point<T>::value)
+            r = std::to_chars(tmp, end, (T)get(k), fmt, precision);
+          else
+            r = std::to_chars(tmp, end, (T)get(k));
+          if (r.ec != std::errc())
+          {
+            failed = true;
+            return;
+          }
+          *r.ptr++ = ' ';
+          if (rowLen && (k + 1) % rowLen == 0)
+            *r.ptr++ = '\n';
+          s.append(tmp, r.ptr);
+        }
+      });
+      if (failed)
+      {
+        ostr.setstate(std::ios_base::failbit);
+        return;
+      }
+      for (size_t t = 0; t < nb; t++)
+        if (ostr.rdbuf()->sputn(bufs[t].data(), (std::streamsize)bufs[t].size()) != (std::streamsize)bufs[t].size())
+        {
+          ostr.setstate(std::ios_base::badbit);
+          return;
+        }
+    }
+  }
+
+  // count чисел, разделённых пробельными символами, в set(k, x); при ошибке - failbit
+  template<typename T, typename Set>
+  static void read(std::istream& istr, size_t count, Set set)
+  {
+    std::istream::sentry ok(istr);
+    if (!ok)
+      return;
+    std::streambuf* sb = istr.rdbuf();
+    const int EOF_ = std::char_traits<char>::eof();
+    auto isSpace = [](int c) { return c == ' ' || (c >= '\t' && c <= '\r'); };
+    size_t batch = 2 * TParallel::concurrency() * BLOCK;
+    std::string text;
+    std::vector<size_t> starts;
+    for (size_t first = 0; first < count; first += batch)
+    {
+      size_t n = std::min(batch, count - first);
+      // лексемы - последовательно (поток читается ровно до конца последнего числа)
+      text.clear();
+      starts.clear();
+      for (size_t k = 0; k < n; k++)
+      {
+        int c = sb->sgetc();
+        while (c != EOF_ && isSpace(c))
+          c = sb->snextc();
+        if (c == EOF_)
+        {
+          istr.setstate(std::ios_base::eofbit | std::ios_base::failbit);
+          return;
+        }
+        starts.push_back(text.size());
+        while (c != EOF_ && !isSpace(c))
+        {
+          text.push_back((char)c);
+          c = sb->snextc();
+        }
+        if (c == EOF_)
+          istr.setstate(std::ios_base::eofbit);
+      }
+      starts.push_back(text.size());
+      // разбор - параллельно по блокам
+      std::atomic<bool> good(true);
+      TParallel::forEach((n + BLOCK - 1) / BLOCK, [&](size_t b) {
+        for (size_t k = b * BLOCK; k < std::min(n, (b + 1) * BLOCK); k++)
+        {
+          const char* s = text.data() + starts[k];
+          const char* e = text.data() + starts[k + 1];
+          if (e - s > 1 && *s == '+' && s[1] != '-')
+            s++;
+          T x;
+          std::from_chars_result r = std::from_chars(s, e, x);
+          if (r.ec != std::errc() || r.ptr != e)
+          {
+            good = false;
+            return;
+          }
+          set(first + k, x);
+        }
+      });
+      if (!good)
+      {
+        istr.setstate(std::ios_base::failbit);
+        return;
+      }
+    }
+  }
+};
+
+
+// Буферизованное чтение текста блоками по CHUNK байт -
+// числа разбираются std::from_chars прямо из буфера, без строки на элемент;
+// поток читается вперёд блоками, поэтому за данными в нём ничего не должно быть
+class TTextReader
+{
+  std::istream& in;
+  std::vector<char> buf;
+  size_t pos = 0, end = 0;
+  size_t line = 1;
+
+  // дочитать следующий блок, сохранив непрочитанный остаток; false - конец потока
+  bool fill()
+  {
+    std::memmove(buf.data(), buf.data() + pos, end - pos);
+    end -= pos;
+    pos = 0;
+    if (end == buf.size())
+      buf.resize(buf.size() * 2); // лексема длиннее блока
+    std::streamsize got = in.rdbuf()->sgetn(buf.data() + end, (std::streamsize)(buf.size() - end));
+    if (got <= 0)
+    {
+      in.setstate(std::ios_base::eofbit);
+      return false;
+    }
+    end += (size_t)got;
+    return true;
+  }
+  static bool isDelimiter(int c, char sep) noexcept
+  {
+    return c == ' ' || (c >= '\t' && c <= '\r') || c == sep || c == '"';
+  }
+public:
+  static constexpr size_t CHUNK = 1 << 20;
+  static constexpr int END = std::char_traits<char>::eof();
+
+  explicit TTextReader(std::istream& istr) : in(istr), buf(CHUNK) {}
+
+  // номер текущей строки (с 1) - для сообщений об ошибках
+  size_t lineNo() const noexcept { return line; }
+
+  int peek()
+  {
+    if (pos == end && !fill())
+      return END;
+    return (unsigned char)buf[pos];
+  }
+  int get()
+  {
+    int c = peek();
+    if (c != END)
+    {
+      pos++;
+      if (c == '\n')
+        line++;
+    }
+    return c;
+  }
+  // пропустить пробелы и табуляции (но не конец строки)
+  void skipBlanks()
+  {
+    for (int c = peek(); c == ' ' || c == '\t'; c = peek())
+      pos++;
+  }
+  // перейти на следующую строку; false - строк больше нет
+  bool skipLine()
+  {
+    for (int c = get(); c != '\n'; c = get())
+      if (c == END)
+        return false;
+    return true;
+  }
+  // конец строки: "\n", "\r\n" или конец потока
+  bool atEol()
+  {
+    skipBlanks();
+    int c = peek();
+    return c == '\n' || c == '\r' || c == END;
+  }
+  // слово до пробельного символа (для заголовков)
+  std::string word()
+  {
+    skipBlanks();
+    std::string w;
+    for (int c = peek(); c != END && !isDelimiter(c, ' '); c = peek())
+    {
+      w.push_back((char)c);
+      pos++;
+    }
+    return w;
+  }
+
+  // число до пробельного символа, кавычки или sep; при ошибке позиция не меняется
+  template<typename T>
+  bool number(T& x, char sep = ' ')
+  {
+    static_assert(std::is_arithmetic<T>::value, "number() requires arithmetic T");
+    skipBlanks();
+    size_t k = pos;
+    for (;;)
+    {
+      while (k < end && !isDelimiter((unsigned char)buf[k], sep))
+        k++;
+      if (k < end)
+        break;
+      size_t offset = k - pos; // fill() сдвигает буфер к началу
+      bool more = fill();
+      k = pos + offset;
+      if (!more)
+        break;
+    }
+    const char* s = buf.data() + pos;
+    const char* e = buf.data() + k;
+    if (e - s > 1 && *s == '+' && s[1] != '-')
+      s++;
+    std::from_chars_result r = std::from_chars(s, e, x);
+    if (s == e || r.ec != std::errc() || r.ptr != e)
+      return false;
+    pos = k;
+    return true;
+  }
+};
+
+// Буферизованная запись текста блоками по CHUNK байт;
+// числа - кратчайшей записью, при чтении дающей то же значение
+class TTextWriter
+{
+  std::ostream& out;
+  std::vector<char> buf;
+  size_t n = 0;
+public:
+  static constexpr size_t CHUNK = 1 << 20;
+
+  explicit TTextWriter(std::ostream& ostr) : out(ostr), buf(CHUNK) {}
+  TTextWriter(const TTextWriter&) = delete;
+  TTextWriter& operator=(const TTextWriter&) = delete;
+  ~TTextWriter() { flush(); }
+
+  void flush()
+  {
+    if (n && out.rdbuf()->sputn(buf.data(), (std::streamsize)n) != (std::streamsize)n)
+      out.setstate(std::ios_base::badbit);
+    n = 0;
+  }
+  void put(char c)
+  {
+    if (n == buf.size())
+      flush();
+    buf[n++] = c;
+  }
+  void put(const std::string& s)
+  {
+    for (char c : s)
+      put(c);
+  }
+  template<typename T>
+  void number(T x)
+  {
+    static_assert(std::is_arithmetic<T>::value, "number() requires arithmetic T");
+    if (buf.size() - n < 64)
+      flush();
+    std::to_chars_result r = std::to_chars(buf.data() + n, buf.data() + buf.size(), x);
+    n = (size_t)(r.ptr - buf.data());
+  }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include "tbatch.h"
+
+#include <gtest.h>
+
+namespace
+{
+  // пакет с псевдослучайными элементами и i-я матрица пакета отдельно
+  TMatrixBatch<double> makeBatch(size_t count, size_t rows, size_t cols, unsigned seed)
+  {
+    TMatrixBatch<double> m(count, rows, cols);
+    for (size_t b = 0; b < count; b++)
+      for (size_t i = 0; i < rows; i++)
+        for (size_t j = 0; j < cols; j++)
+        {
+          seed = seed * 1103515245u + 12345u;
+          m(b, i, j) = (double)(seed >> 16 & 0xff) / 64.0 - 2.0 + (i == j ? 8.0 : 0.0);
+        }
+    return m;
+  }
+}
+
+TEST(TMatrixBatch, can_create_batch)
+{
+  ASSERT_NO_THROW(TMatrixBatch<int> m(10, 3, 4));
+  ASSERT_ANY_THROW(TMatrixBatch<int> m(0, 3, 4));
+  EXPECT_THROW(TMatrixBatch<int> m(((size_t)1 << 62) + 1, 2, 2), out_of_range);
+  EXPECT_THROW(TMatrixBatch<int> m(MAX_VECTOR_SIZE / 4 + 1, 2, 2), out_of_range);
+}
+
+TEST(TMatrixBatch, stores_matrices_interleaved)
+{
+  TMatrixBatch<int> m(3, 2, 2);
+  m(1, 0, 1) = 5;
+  EXPECT_EQ(5, m.data()[(0 * 2 + 1) * 3 + 1]);
+  EXPECT_EQ(5, m.matrix(1)(0, 1));
+  EXPECT_EQ(5, m.lanes(0, 1)[1]);
+  ASSERT_ANY_THROW(m.at(3, 0, 0));
+}
+
+TEST(TMatrixBatch, can_add_and_subtract_batches)
+{
+  TMatrixBatch<double> a = makeBatch(5, 3, 3, 1), b = makeBatch(5, 3, 3, 2);
+  TMatrixBatch<double> s = a + b, d = a - b;
+  for (size_t k = 0; k < 5; k++)
+  {
+    EXPECT_EQ(TDynamicMatrix<double>(a.matrix(k)) + b.matrix(k), TDynamicMatrix<double>(s.matrix(k)));
+    EXPECT_EQ(TDynamicMatrix<double>(a.matrix(k)) - b.matrix(k), TDynamicMatrix<double>(d.matrix(k)));
+  }
+  ASSERT_ANY_THROW(a + makeBatch(4, 3, 3, 1));
+}
+
+TEST(TMatrixBatch, multiply_matches_single_matrix_products)
+{
+  TMatrixBatch<double> a = makeBatch(1000, 4, 3, 3), b = makeBatch(1000, 3, 5, 4);
+  TMatrixBatch<double> c = a * b;
+  EXPECT_EQ(4, c.rows());
+  EXPECT_EQ(5, c.cols());
+  for (size_t k = 0; k < 1000; k += 97)
+  {
+    TDynamicMatrix<double> e = TDynamicMatrix<double>(a.matrix(k)) * b.matrix(k);
+    for (size_t i = 0; i < 4; i++)
+      for (size_t j = 0; j < 5; j++)
+        EXPECT_DOUBLE_EQ(e[i][j], c(k, i, j));
+  }
+  ASSERT_ANY_THROW(a * a);
+}
+
+TEST(TMatrixBatch, can_multiply_batch_by_vector)
+{
+  TMatrixBatch<double> a = makeBatch(300, 3, 4, 5);
+  TDynamicVector<double> v(4);
+  v[0] = 1.0; v[1] = -2.0; v[3] = 0.5;
+  TMatrixBatch<double> r = a * v;
+  EXPECT_EQ(1, r.cols());
+  for (size_t k = 0; k < 300; k += 31)
+  {
+    TDynamicVector<double> e = a.matrix(k) * v;
+    for (size_t i = 0; i < 3; i++)
+      EXPECT_DOUBLE_EQ(e[i], r(k, i, 0));
+  }
+}
+
+TEST(TMatrixBatch, can_solve_batched_systems)
+{
+  TMatrixBatch<double> a = makeBatch(700, 6, 6, 6), x = makeBatch(700, 6, 2, 7);
+  a(3, 0, 0) = 0.0; // требуется перестановка строк
+  TMatrixBatch<double> r = a.solve(a * x);
+  for (size_t k = 0; k < 700; k++)
+    for (size_t i = 0; i < 6; i++)
+      for (size_t j = 0; j < 2; j++)
+        EXPECT_NEAR(x(k, i, j), r(k, i, j), 1e-10);
+}
+
+TEST(TMatrixBatch, solve_with_copy_on_write_detaches_before_parallel_lanes)
+{
+  size_t old = TParallel::threads;
+  bool oldCow = TMemory::copyOnWrite;
+  TParallel::threads = 4;
+  TMemory::copyOnWrite = true;
+  TMatrixBatch<double> a = makeBatch(2000, 5, 5, 8), x = makeBatch(2000, 5, 1, 9);
+  TMatrixBatch<double> b = a * x;
+  TMatrixBatch<double> r = a.solve(b); // копии a и b внутри solve делят буферы с оригиналами
+  TMemory::copyOnWrite = oldCow;
+  TParallel::threads = old;
+  for (size_t k = 0; k < 2000; k++)
+    for (size_t i = 0; i < 5; i++)
+      ASSERT_NEAR(x(k, i, 0), r(k, i, 0), 1e-10);
+  EXPECT_EQ(makeBatch(2000, 5, 5, 8)(7, 1, 2), a(7, 1, 2));
+}
+
+TEST(TMatrixBatch, throws_when_solving_singular_system)
+{
+  TMatrixBatch<double> a(4, 2, 2), b(4, 2, 1);
+  for (size_t k = 0; k < 4; k++)
+    a(k, 0, 0) = a(k, 1, 1) = 1.0;
+  a(2, 1, 1) = 0.0;
+  ASSERT_ANY_THROW(a.solve(b));
+}
@@ -0,0 +1,119 @@
+#include "tcompact.h"
+
+#include <cmath>
+#include <gtest.h>
+
+TEST(THalf, converts_exactly_representable_values)
+{
+  EXPECT_EQ(1.0f, (float)THalf(1.0f));
+  EXPECT_EQ(-2.5f, (float)THalf(-2.5f));
+  EXPECT_EQ(65504.0f, (float)THalf(65504.0f));
+  EXPECT_EQ(0x3c00, THalf(1.0f).bits);
+}
+
+TEST(THalf, handles_subnormals_and_overflow)
+{
+  float tiny = std::ldexp(1.0f, -24);
+  EXPECT_EQ(tiny, (float)THalf(tiny));
+  EXPECT_TRUE(std::isinf((float)THalf(1e6f)));
+  EXPECT_TRUE(std::isnan((float)THalf(NAN)));
+}
+
+TEST(TBFloat16, keeps_float_range)
+{
+  EXPECT_EQ(1.0f, (float)TBFloat16(1.0f));
+  EXPECT_NEAR(3.0e38f, (float)TBFloat16(3.0e38f), 3.0e38f / 128);
+  EXPECT_EQ(0x3f80, TBFloat16(1.0f).bits);
+}
+
+TEST(THalf, half_vector_dot_product_matches_float)
+{
+  const size_t n = 1000;
+  TDynamicVector<float> a(n), b(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    a[i] = (float)(i % 7) - 3.0f;
+    b[i] = 0.5f * (float)(i % 5);
+  }
+  TDynamicVector<THalf> ha(a), hb(b);
+  EXPECT_EQ(2 * sizeof(THalf), sizeof(float));
+  EXPECT_FLOAT_EQ(a * b, (float)(ha * hb));
+  EXPECT_FLOAT_EQ(a * b, ha * b);
+}
+
+TEST(TBFloat16, long_dot_product_accumulates_blocks_in_double)
+{
+  const size_t n = 3000000;
+  TDynamicVector<TBFloat16> a(n), b(n);
+  double exact = 0.0;
+  for (size_t i = 0; i < n; i++)
+  {
+    a[i] = TBFloat16(0.1f + 0.01f * (float)(i % 13));
+    b[i] = TBFloat16(0.7f + (float)(i % 3));
+    exact += (double)(float)a[i] * (double)(float)b[i];
+  }
+  TVectorView<const TBFloat16> x(a), y(b);
+  size_t old = TParallel::threads;
+  TParallel::threads = 1;
+  float serial = x.dot<float>(y);
+  TParallel::threads = 4;
+  float parallel = x.dot<float>(y);
+  TParallel::threads = old;
+  EXPECT_EQ((float)exact, serial); // суммы блоков во float теряют младшие разряды
+  EXPECT_EQ(serial, parallel);
+}
+
+TEST(THalf, vector_equality_follows_element_equality)
+{
+  TDynamicVector<THalf> p(3), m(3);
+  p[0] = THalf(0.0f);
+  m[0] = THalf(-0.0f);
+  EXPECT_TRUE(p[0] == m[0]);
+  EXPECT_TRUE(p == m);
+  TDynamicVector<TBFloat16> bp(2), bm(2);
+  bm[1] = TBFloat16(-0.0f);
+  EXPECT_TRUE(bp == bm);
+  p[1] = THalf(NAN);
+  const TDynamicVector<THalf>& n = p;
+  EXPECT_FALSE(n == n);
+  EXPECT_FALSE(p == m);
+}
+
+TEST(THalf, can_convert_matrix_to_half_and_back)
+{
+  TDynamicMatrix<float> m(3);
+  m[0][1] = 0.25f;
+  m[2][0] = -8.0f;
+  TDynamicMatrix<THalf> h(m);
+  EXPECT_EQ(m, TDynamicMatrix<float>(h));
+}
+
+TEST(TQuantizedMatrix, matrix_vector_product_is_close_to_float)
+{
+  TDynamicMatrix<float> m(4, 8);
+  TDynamicVector<float> v(8);
+  for (size_t j = 0; j < 8; j++)
+  {
+    v[j] = 0.1f * (float)j;
+    for (size_t i = 0; i < 4; i++)
+      m[i][j] = (float)(i + 1) * ((float)j - 3.5f);
+  }
+  TQuantizedMatrix q(m);
+  TDynamicVector<float> exact = m * v, r1 = q * v, r2 = q.multiplyQuantized(v);
+  for (size_t i = 0; i < 4; i++)
+  {
+    EXPECT_NEAR(exact[i], r1[i], 0.02f * std::fabs(exact[i]) + 1e-3f);
+    EXPECT_NEAR(exact[i], r2[i], 0.02f * std::fabs(exact[i]) + 1e-3f);
+  }
+}
+
+TEST(TQuantizedMatrix, dequantize_restores_row_maximum)
+{
+  TDynamicMatrix<float> m(2);
+  m[0][0] = 2.0f; m[0][1] = -1.0f;
+  m[1][0] = 0.0f; m[1][1] = 0.0f;
+  TQuantizedMatrix q(m);
+  TDynamicMatrix<float> d = q.dequantize();
+  EXPECT_FLOAT_EQ(2.0f, d[0][0]);
+  EXPECT_EQ(0.0f, d[1][1]);
+}
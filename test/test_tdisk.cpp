@@ -0,0 +1,112 @@
+#include "tdisk.h"
+
+#include <cstdio>
+#include <cstring>
+#include <gtest.h>
+#if defined(__linux__)
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+  TDynamicMatrix<double> sample(size_t rows, size_t cols, double seed)
+  {
+    TDynamicMatrix<double> m(rows, cols);
+    for (size_t i = 0; i < rows; i++)
+      for (size_t j = 0; j < cols; j++)
+        m[i][j] = (double)((i * 31 + j * 17) % 23) - seed;
+    return m;
+  }
+#if defined(__linux__)
+  // наименьший свободный дескриптор: растёт, если какой-то файл остался открытым
+  int nextFd()
+  {
+    int fd = open("/dev/null", O_RDONLY);
+    close(fd);
+    return fd;
+  }
+#endif
+}
+
+TEST(TDiskMatrix, new_matrix_is_zero_and_keeps_blocks)
+{
+  TDiskMatrix<double> d("tdisk_a.bin", 50, 70, 16);
+  EXPECT_EQ(4u, d.tileRows());
+  EXPECT_EQ(5u, d.tileCols());
+  EXPECT_EQ(0.0, d.get(49, 69));
+  TDynamicMatrix<double> m = sample(20, 30, 3.0);
+  d.assign(m, 10, 25);
+  EXPECT_EQ(m, d.read(10, 25, 20, 30));
+  EXPECT_EQ(m[5][7], d.get(15, 32));
+  EXPECT_EQ(0.0, d.get(9, 25));
+  EXPECT_THROW(d.assign(m, 40, 0), out_of_range);
+  remove("tdisk_a.bin");
+}
+
+TEST(TDiskMatrix, evicted_tiles_survive_and_file_reopens)
+{
+  TDynamicMatrix<double> m = sample(40, 40, 1.0);
+  {
+    TDiskMatrix<double> d("tdisk_b.bin", 40, 40, 8);
+    d.setCacheBudget(3 * 8 * 8 * sizeof(double));
+    d.assign(m);
+    EXPECT_LE(d.cacheBytes(), d.cacheBudget());
+    EXPECT_EQ(m, d.read(0, 0, 40, 40));
+  }
+  TDiskMatrix<double> r("tdisk_b.bin");
+  EXPECT_EQ(40u, r.rows());
+  EXPECT_EQ(8u, r.tileSize());
+  EXPECT_EQ(m, r.read(0, 0, 40, 40));
+  EXPECT_THROW(TDiskMatrix<float>("tdisk_b.bin"), runtime_error);
+  remove("tdisk_b.bin");
+}
+
+TEST(TDiskMatrix, failed_open_closes_the_file)
+{
+  uint64_t header[5] = { 0, sizeof(double), 0, 4, 2 }; // нулевое число строк
+  memcpy(header, "TDISKMAT", 8);
+  FILE* f = fopen("tdisk_c.bin", "wb");
+  ASSERT_NE(nullptr, f);
+  fwrite(header, sizeof(header), 1, f);
+  fclose(f);
+#if defined(__linux__)
+  int fd = nextFd();
+#endif
+  EXPECT_THROW(TDiskMatrix<double>("tdisk_c.bin"), out_of_range);
+  f = fopen("tdisk_c.bin", "wb");
+  ASSERT_NE(nullptr, f);
+  fclose(f);
+  EXPECT_THROW(TDiskMatrix<double>("tdisk_c.bin"), runtime_error);
+#if defined(__linux__)
+  EXPECT_EQ(fd, nextFd());
+#endif
+  remove("tdisk_c.bin");
+}
+
+TEST(TDiskMatrix, tiled_kernels_match_dense)
+{
+  size_t old = TParallel::threads;
+  TParallel::threads = 4;
+  TDynamicMatrix<double> a = sample(37, 29, 2.0), b = sample(29, 45, 5.0), s = sample(37, 29, 7.0);
+  TDynamicVector<double> v(29);
+  for (size_t j = 0; j < 29; j++)
+    v[j] = (double)j - 10.0;
+  {
+    TDiskMatrix<double> da("tdisk_c1.bin", 37, 29, 8), db("tdisk_c2.bin", 29, 45, 8);
+    TDiskMatrix<double> ds("tdisk_c3.bin", 37, 29, 8), dc("tdisk_c4.bin", 37, 45, 8);
+    da.setCacheBudget(4 * 8 * 8 * sizeof(double));
+    da.assign(a);
+    db.assign(b);
+    ds.assign(s);
+    TDiskMatrix<double>::multiply(da, db, dc);
+    EXPECT_EQ(a * b, dc.read(0, 0, 37, 45));
+    TDiskMatrix<double>::add(da, ds, ds);
+    EXPECT_EQ(a + s, ds.read(0, 0, 37, 29));
+    EXPECT_EQ(a * v, da * v);
+    EXPECT_THROW(TDiskMatrix<double>::multiply(da, db, da), out_of_range);
+  }
+  TParallel::threads = old;
+  for (const char* f : { "tdisk_c1.bin", "tdisk_c2.bin", "tdisk_c3.bin", "tdisk_c4.bin" })
+    remove(f);
+}
@@ -0,0 +1,127 @@
+#include "tformat.h"
+
+#include <cmath>
+#include <sstream>
+#include <gtest.h>
+
+TEST(TCsv, reads_shape_and_skips_header)
+{
+  istringstream s("a,b,c\r\n1,2.5,-3\r\n\r\n4, \"5\" ,+6e1\r\n");
+  TDynamicMatrix<double> m = TCsv::read<double>(s);
+  ASSERT_EQ(2u, m.rows());
+  ASSERT_EQ(3u, m.cols());
+  EXPECT_EQ(2.5, m[0][1]);
+  EXPECT_EQ(5.0, m[1][1]);
+  EXPECT_EQ(60.0, m[1][2]);
+}
+
+TEST(TCsv, reads_last_line_without_newline)
+{
+  istringstream s("1,2\n3,4");
+  TDynamicMatrix<int> m = TCsv::read<int>(s);
+  ASSERT_EQ(2u, m.rows());
+  EXPECT_EQ(4, m[1][1]);
+}
+
+TEST(TCsv, throws_on_ragged_rows)
+{
+  istringstream s("1,2\n3\n");
+  EXPECT_THROW(TCsv::read<int>(s), runtime_error);
+  istringstream t("1,2\n3,x\n");
+  EXPECT_THROW(TCsv::read<int>(t), runtime_error);
+}
+
+TEST(TCsv, round_trip_is_exact_across_chunks)
+{
+  TDynamicMatrix<double> m(2000, 60);
+  for (size_t i = 0; i < m.rows(); i++)
+    for (size_t j = 0; j < m.cols(); j++)
+      m[i][j] = sin((double)(i * 60 + j)) / 7.0;
+  stringstream s;
+  TCsv::write<double>(s, m, ';');
+  EXPECT_GT(s.str().size(), TTextReader::CHUNK); // числа пересекают границы блоков
+  TDynamicMatrix<double> r = TCsv::read<double>(s, ';', TMatrixLayout::ColMajor);
+  EXPECT_EQ(m, r);
+}
+
+TEST(TMatrixMarket, reads_symmetric_coordinate)
+{
+  istringstream s(
+    "%%MatrixMarket matrix coordinate real symmetric\n"
+    "% comment\n"
+    "3 3 3\n"
+    "1 1 2.0\n"
+    "3 1 -1.5\n"
+    "2 2 4\n");
+  TDynamicMatrix<double> m = TMatrixMarket::readDense<double>(s);
+  EXPECT_EQ(2.0, m[0][0]);
+  EXPECT_EQ(-1.5, m[2][0]);
+  EXPECT_EQ(-1.5, m[0][2]);
+  EXPECT_EQ(0.0, m[1][0]);
+  istringstream t(s.str());
+  TSparseMatrix<double> sp = TMatrixMarket::readSparse<double>(t);
+  EXPECT_EQ(4u, sp.nnz());
+  EXPECT_EQ(m, sp.toDense());
+}
+
+TEST(TMatrixMarket, reads_last_entry_without_newline)
+{
+  istringstream s("%%MatrixMarket matrix coordinate integer general\n2 2 2\n1 1 3\n2 2 7");
+  TDynamicMatrix<int> m = TMatrixMarket::readDense<int>(s);
+  EXPECT_EQ(3, m[0][0]);
+  EXPECT_EQ(7, m[1][1]);
+}
+
+TEST(TMatrixMarket, reads_skew_symmetric_array)
+{
+  istringstream s("%%MatrixMarket matrix array integer skew-symmetric\n3 3\n1\n2\n3\n");
+  TDynamicMatrix<int> m = TMatrixMarket::readDense<int>(s);
+  EXPECT_EQ(1, m[1][0]);
+  EXPECT_EQ(-1, m[0][1]);
+  EXPECT_EQ(2, m[2][0]);
+  EXPECT_EQ(3, m[2][1]);
+  EXPECT_EQ(-3, m[1][2]);
+  EXPECT_EQ(0, m[1][1]);
+}
+
+TEST(TMatrixMarket, round_trips_dense_and_sparse)
+{
+  TDynamicMatrix<double> m(4, 3);
+  m[0][1] = 0.1; m[2][0] = -7.25; m[3][2] = 1e-300;
+  stringstream d;
+  TMatrixMarket::writeDense<double>(d, m);
+  EXPECT_EQ(m, TMatrixMarket::readDense<double>(d));
+  TSparseMatrix<double> sp = TSparseMatrix<double>::fromDense(m);
+  EXPECT_EQ(3u, sp.nnz());
+  stringstream c;
+  TMatrixMarket::writeSparse(c, sp);
+  EXPECT_EQ(m, TMatrixMarket::readSparse<double>(c).toDense());
+}
+
+TEST(TMatrixMarket, rejects_bad_files)
+{
+  istringstream complex("%%MatrixMarket matrix coordinate complex general\n1 1 1\n1 1 1 0\n");
+  EXPECT_THROW(TMatrixMarket::readDense<double>(complex), runtime_error);
+  istringstream range("%%MatrixMarket matrix coordinate real general\n2 2 1\n3 1 1\n");
+  EXPECT_THROW(TMatrixMarket::readDense<double>(range), runtime_error);
+  istringstream shortData("%%MatrixMarket matrix coordinate real general\n2 2 2\n1 1 1\n");
+  EXPECT_THROW(TMatrixMarket::readDense<double>(shortData), runtime_error);
+}
+
+TEST(TSparseMatrix, compress_merges_duplicates_and_multiplies)
+{
+  TSparseMatrix<double> a(2, 3);
+  a.add(1, 2, 1.0);
+  a.add(0, 0, 2.0);
+  a.add(1, 2, 3.0);
+  EXPECT_THROW(a.add(2, 0, 1.0), out_of_range);
+  a.compress();
+  ASSERT_EQ(2u, a.nnz());
+  EXPECT_EQ(0u, a.entry(0).row);
+  EXPECT_EQ(4.0, a.entry(1).value);
+  TDynamicVector<double> x(3);
+  x[0] = 1.0; x[2] = 2.0;
+  TDynamicVector<double> y = a * x;
+  EXPECT_EQ(2.0, y[0]);
+  EXPECT_EQ(8.0, y[1]);
+}
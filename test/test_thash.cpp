@@ -0,0 +1,43 @@
+#include "thash.h"
+
+#include <cstring>
+#include <gtest.h>
+
+TEST(THash64, matches_reference_values)
+{
+  EXPECT_EQ(0xEF46DB3751D8E999ull, THash64().digest());
+  EXPECT_EQ(0x44BC2CF5AD770999ull, THash64().update("abc", 3).digest());
+}
+
+TEST(THash64, streaming_does_not_depend_on_split)
+{
+  char data[200];
+  for (int i = 0; i < 200; i++)
+    data[i] = (char)(i * 7 + 3);
+  uint64_t whole = THash64(42).update(data, sizeof(data)).digest();
+  for (size_t cut : { 1, 5, 31, 32, 33, 100, 199 })
+  {
+    THash64 h(42);
+    h.update(data, cut).update(data + cut, sizeof(data) - cut);
+    EXPECT_EQ(whole, h.digest());
+  }
+  EXPECT_NE(whole, THash64(43).update(data, sizeof(data)).digest());
+}
+
+TEST(TCrc32c, matches_check_value)
+{
+  const char* s = "123456789";
+  EXPECT_EQ(0xE3069283u, TCrc32c().update(s, strlen(s)).digest());
+  EXPECT_EQ(0xE3069283u, TCrc32c().update(s, 4).update(s + 4, 5).digest());
+  EXPECT_EQ(0u, TCrc32c().digest());
+}
+
+TEST(TCrc32, matches_reference_value)
+{
+  EXPECT_EQ(0xCBF43926u, TCrc32().update("123456789", 9).digest());
+  EXPECT_EQ(0u, TCrc32().digest());
+  char data[100];
+  for (int i = 0; i < 100; i++)
+    data[i] = (char)(i * 13 + 1);
+  EXPECT_EQ(TCrc32().update(data, 100).digest(), TCrc32().update(data, 37).update(data + 37, 63).digest());
+}
@@ -1,5 +1,8 @@
 #include "tmatrix.h"
 
+#include <cmath>
+#include <iomanip>
+#include <sstream>
 #include <gtest.h>
 
 TEST(TDynamicMatrix, can_create_matrix_with_positive_length)
@@ -171,3 +174,623 @@ TEST(TDynamicMatrix, cant_subtract_matrixes_with_not_equal_size)
   TDynamicMatrix<int> a(2), b(3);
   EXPECT_ANY_THROW(a - b);
 }
+
+TEST(TDynamicMatrix, block_refers_to_matrix_memory)
+{
+  TDynamicMatrix<int> m(4);
+  TMatrixView<int> b = m.block(1, 2, 2, 2);
+  b(1, 0) = 5;
+  EXPECT_EQ(2, b.rows());
+  EXPECT_EQ(5, m[2][2]);
+}
+
+TEST(TDynamicMatrix, throws_when_block_is_out_of_range)
+{
+  TDynamicMatrix<int> m(3);
+  EXPECT_ANY_THROW(m.block(2, 0, 2, 1));
+}
+
+TEST(TDynamicMatrix, column_is_strided_view)
+{
+  TDynamicMatrix<int> m(3);
+  for (size_t i = 0; i < 3; i++)
+    m[i][1] = (int)i + 1;
+  TDynamicVector<int> v(3);
+  v[0] = 1; v[1] = 1; v[2] = 1;
+  EXPECT_EQ(6, m.col(1) * v);
+}
+
+TEST(TDynamicMatrix, can_multiply_matrix_by_vector)
+{
+  TDynamicMatrix<int> m(2);
+  m[0][0] = 1; m[0][1] = 2;
+  m[1][0] = 3; m[1][1] = 4;
+  TDynamicVector<int> v(2);
+  v[0] = 1; v[1] = 1;
+  TDynamicVector<int> r = m * v;
+  EXPECT_EQ(3, r[0]);
+  EXPECT_EQ(7, r[1]);
+}
+
+TEST(TDynamicMatrix, can_multiply_matrices_with_equal_size)
+{
+  TDynamicMatrix<int> a(2), b(2);
+  a[0][0] = 1; a[0][1] = 2;
+  a[1][0] = 3; a[1][1] = 4;
+  b[0][0] = 5; b[0][1] = 6;
+  b[1][0] = 7; b[1][1] = 8;
+  TDynamicMatrix<int> c = a * b;
+  EXPECT_EQ(19, c[0][0]);
+  EXPECT_EQ(22, c[0][1]);
+  EXPECT_EQ(43, c[1][0]);
+  EXPECT_EQ(50, c[1][1]);
+}
+
+TEST(TDynamicMatrix, can_multiply_blocks_in_place)
+{
+  TDynamicMatrix<int> a(4), c(4);
+  for (size_t i = 0; i < 4; i++)
+    for (size_t j = 0; j < 4; j++)
+      a[i][j] = (int)(i + j);
+  c.block(2, 2, 2, 2).addProduct(a.block(0, 0, 2, 3), a.block(1, 1, 3, 2));
+  TDynamicMatrix<int> r = TDynamicMatrix<int>(a.block(0, 0, 2, 3)) * a.block(1, 1, 3, 2);
+  EXPECT_EQ(TDynamicMatrix<int>(c.block(2, 2, 2, 2)), r);
+  EXPECT_EQ(0, c[0][0]);
+}
+
+TEST(TDynamicMatrix, can_add_rectangular_blocks)
+{
+  TDynamicMatrix<int> m(3);
+  m[0][0] = 1; m[2][2] = 2;
+  TDynamicMatrix<int> r = m.block(0, 0, 1, 3) + m.block(2, 0, 1, 3);
+  EXPECT_EQ(1, r.rows());
+  EXPECT_EQ(3, r.cols());
+  EXPECT_EQ(1, r[0][0]);
+  EXPECT_EQ(2, r[0][2]);
+}
+
+TEST(TDynamicMatrix, column_major_matrix_has_same_elements)
+{
+  TDynamicMatrix<int> a(2, 3), b(2, 3, TMatrixLayout::ColMajor);
+  for (size_t i = 0; i < 2; i++)
+    for (size_t j = 0; j < 3; j++)
+      a[i][j] = b[i][j] = (int)(i * 3 + j);
+  EXPECT_EQ(TMatrixLayout::ColMajor, b.layout());
+  EXPECT_EQ(3, b.data()[1]);
+  EXPECT_EQ(a, b);
+}
+
+TEST(TDynamicMatrix, can_multiply_column_major_matrices)
+{
+  TDynamicMatrix<int> a(2), b(2, 2, TMatrixLayout::ColMajor), c(2, 2, TMatrixLayout::ColMajor);
+  a[0][0] = 1; a[0][1] = 2;
+  a[1][0] = 3; a[1][1] = 4;
+  b = TDynamicMatrix<int>(a, TMatrixLayout::ColMajor);
+  c = b * b;
+  TDynamicVector<int> v(2);
+  v[0] = 1; v[1] = 1;
+  EXPECT_EQ(TMatrixLayout::ColMajor, c.layout());
+  EXPECT_EQ(a * a, c);
+  EXPECT_EQ(a * v, b * v);
+  EXPECT_EQ(a + a, b + a);
+}
+
+TEST(TDynamicMatrix, binary_io_converts_layout)
+{
+  TDynamicMatrix<double> a(2, 3), b(1, 1, TMatrixLayout::ColMajor);
+  for (size_t i = 0; i < 2; i++)
+    for (size_t j = 0; j < 3; j++)
+      a[i][j] = i - 0.5 * j;
+  stringstream s;
+  a.writeBinary(s);
+  b.readBinary(s);
+  EXPECT_EQ(TMatrixLayout::ColMajor, b.layout());
+  EXPECT_EQ(a, b);
+}
+
+TEST(TDynamicMatrix, can_multiply_float_matrix_by_double_vector)
+{
+  TDynamicMatrix<float> m(2);
+  m[0][0] = 1.5f; m[0][1] = 2.0f;
+  m[1][0] = 0.5f; m[1][1] = 4.0f;
+  TDynamicVector<double> v(2);
+  v[0] = 0.1; v[1] = 0.2;
+  TDynamicVector<double> r = m * v;
+  EXPECT_DOUBLE_EQ(1.5 * 0.1 + 2.0 * 0.2, r[0]);
+  EXPECT_DOUBLE_EQ(0.5 * 0.1 + 4.0 * 0.2, r[1]);
+}
+
+TEST(TDynamicMatrix, can_multiply_matrices_with_different_element_types)
+{
+  TDynamicMatrix<int> a(2);
+  TDynamicMatrix<double> b(2);
+  a[0][0] = 1; a[0][1] = 2;
+  a[1][0] = 3; a[1][1] = 4;
+  b[0][0] = 0.5; b[1][1] = 0.25;
+  TDynamicMatrix<double> c = a * b;
+  EXPECT_DOUBLE_EQ(0.5, c[0][0]);
+  EXPECT_DOUBLE_EQ(0.5, c[0][1]);
+  EXPECT_DOUBLE_EQ(1.5, c[1][0]);
+  EXPECT_DOUBLE_EQ(1.0, c[1][1]);
+  EXPECT_DOUBLE_EQ(4.25, (a + b)[1][1]);
+}
+
+TEST(TDynamicMatrix, product_does_not_depend_on_summation_mode_for_integers)
+{
+  TDynamicMatrix<int> a(5, 3), b(3, 4), bc(3, 4, TMatrixLayout::ColMajor);
+  for (size_t i = 0; i < 5; i++)
+    for (size_t j = 0; j < 3; j++)
+      a[i][j] = (int)(i * 3 + j) - 4;
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 4; j++)
+      b[i][j] = bc[i][j] = (int)(i + 2 * j);
+  TSumMode old = TReduction::mode;
+  TReduction::mode = TSumMode::Serial;
+  TDynamicMatrix<int> serial = a * b;
+  TReduction::mode = TSumMode::Kahan;
+  EXPECT_EQ(serial, a * b);
+  EXPECT_EQ(serial, a * bc);
+  TReduction::mode = TSumMode::Pairwise;
+  EXPECT_EQ(serial, a * b);
+  EXPECT_EQ(serial, a * bc);
+  TReduction::mode = old;
+}
+
+TEST(TDynamicMatrix, parallel_product_does_not_depend_on_thread_count)
+{
+  const size_t n = 96;
+  TDynamicMatrix<double> a(n), b(n);
+  for (size_t i = 0; i < n; i++)
+    for (size_t j = 0; j < n; j++)
+    {
+      a[i][j] = 1.0 / (1.0 + (double)(i + j));
+      b[i][j] = (double)((i * 7 + j) % 11) - 5.0;
+    }
+  size_t old = TParallel::threads;
+  TParallel::threads = 1;
+  TDynamicMatrix<double> c1 = a * b;
+  TParallel::threads = 4;
+  EXPECT_EQ(c1, a * b);
+  TParallel::threads = old;
+}
+
+TEST(TDynamicMatrix, self_move_assignment_keeps_matrix)
+{
+  TDynamicMatrix<int> m(2, 3);
+  m[1][2] = 5;
+  TDynamicMatrix<int>& r = m;
+  m = std::move(r);
+  EXPECT_EQ(2u, m.rows());
+  EXPECT_EQ(3u, m.cols());
+  EXPECT_EQ(5, m[1][2]);
+}
+
+TEST(TDynamicMatrix, can_compute_trace_and_norms)
+{
+  TDynamicMatrix<double> m(2);
+  m[0][0] = 1.0; m[0][1] = -2.0;
+  m[1][0] = 3.0; m[1][1] = 4.0;
+  EXPECT_DOUBLE_EQ(5.0, m.trace());
+  EXPECT_DOUBLE_EQ(6.0, m.norm1());
+  EXPECT_DOUBLE_EQ(7.0, m.normInf());
+  EXPECT_DOUBLE_EQ(std::sqrt(30.0), m.normFrobenius());
+  EXPECT_DOUBLE_EQ(6.0, m.sum());
+}
+
+TEST(TDynamicMatrix, float_reductions_accumulate_in_double)
+{
+  TDynamicMatrix<float> m(2, 3);
+  m[0][0] = 1e8f; m[0][1] = 1.0f;
+  m[1][0] = -1e8f;
+  EXPECT_EQ(1.0f, m.block(0, 0, 2, 2).sum());
+  TDynamicMatrix<float> c(2, 17, TMatrixLayout::ColMajor);
+  c[0][0] = 1e8f;
+  for (size_t j = 1; j < 17; j++)
+    c[0][j] = -1.0f;
+  TSumMode old = TReduction::mode;
+  for (TSumMode mode : { TSumMode::Serial, TSumMode::Pairwise, TSumMode::Kahan })
+  {
+    TReduction::mode = mode;
+    EXPECT_EQ(100000016.0f, c.normInf());
+    EXPECT_EQ(100000016.0f, c.view().transpose().norm1());
+  }
+  TReduction::mode = old;
+}
+
+TEST(TDynamicMatrix, can_compute_row_and_column_reductions)
+{
+  TDynamicMatrix<int> m(2, 3, TMatrixLayout::ColMajor);
+  m[0][0] = 1; m[0][1] = 2; m[0][2] = 3;
+  m[1][0] = 4; m[1][1] = 8; m[1][2] = 6;
+  TDynamicVector<int> r = m.rowSums(), c = m.colSums();
+  EXPECT_EQ(6, r[0]);
+  EXPECT_EQ(18, r[1]);
+  EXPECT_EQ(5, c[0]);
+  EXPECT_EQ(10, c[1]);
+  EXPECT_EQ(9, c[2]);
+  EXPECT_EQ(make_pair((size_t)1, (size_t)1), m.argmax());
+  EXPECT_EQ(1, m.min());
+  EXPECT_EQ(19, m.block(0, 1, 2, 2).sum());
+}
+
+TEST(TDynamicMatrix, can_apply_function_to_block)
+{
+  TDynamicMatrix<int> m(3);
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 3; j++)
+      m[i][j] = (int)(i * 3 + j);
+  m.block(1, 1, 2, 2).apply([](int x) { return -x; });
+  EXPECT_EQ(1, m[0][1]);
+  EXPECT_EQ(-4, m[1][1]);
+  EXPECT_EQ(-8, m[2][2]);
+  EXPECT_EQ(6, m[2][0]);
+}
+
+TEST(TDynamicMatrix, can_map_and_zip_matrices)
+{
+  TDynamicMatrix<int> a(2), b(2, 2, TMatrixLayout::ColMajor);
+  a[0][0] = 1; a[0][1] = 2;
+  a[1][0] = 3; a[1][1] = 4;
+  b[0][1] = 10;
+  TDynamicMatrix<double> h = a.map([](int x) { return x / 2.0; });
+  EXPECT_DOUBLE_EQ(1.5, h[1][0]);
+  TDynamicMatrix<int> z = zip(a, b, [](int x, int y) { return x > y ? x : y; });
+  EXPECT_EQ(10, z[0][1]);
+  EXPECT_EQ(3, z[1][0]);
+}
+
+TEST(TDynamicMatrix, can_multiply_matrices_elementwise)
+{
+  TDynamicMatrix<int> a(2), mask(2);
+  a[0][0] = 1; a[0][1] = 2;
+  a[1][0] = 3; a[1][1] = 4;
+  mask[0][1] = 1; mask[1][0] = 1;
+  TDynamicMatrix<int> r = a.cwiseProduct(mask);
+  EXPECT_EQ(0, r[0][0]);
+  EXPECT_EQ(2, r[0][1]);
+  EXPECT_EQ(3, r[1][0]);
+  EXPECT_EQ(r, hadamard(a, mask));
+  a.block(0, 0, 1, 2).cwiseDivide(a.block(1, 0, 1, 2));
+  EXPECT_EQ(0, a[0][0]);
+  EXPECT_EQ(4, a[1][1]);
+}
+
+TEST(TDynamicMatrix, scalar_multiplication_returns_matrix)
+{
+  TDynamicMatrix<int> m(2, 3);
+  m[0][2] = 2;
+  m[1][0] = -1;
+  TDynamicMatrix<int> r = m * 3;
+  EXPECT_EQ(2, r.rows());
+  EXPECT_EQ(3, r.cols());
+  EXPECT_EQ(6, r[0][2]);
+  EXPECT_EQ(-3, r[1][0]);
+  TDynamicMatrix<double> h = m * 0.5;
+  EXPECT_DOUBLE_EQ(-0.5, h[1][0]);
+}
+
+TEST(TDynamicMatrix, can_add_subtract_and_divide_by_scalar)
+{
+  TDynamicMatrix<double> m(2, 2, TMatrixLayout::ColMajor);
+  m[0][1] = 4.0;
+  EXPECT_DOUBLE_EQ(5.0, (m + 1.0)[0][1]);
+  EXPECT_DOUBLE_EQ(-1.0, (m - 1.0)[1][1]);
+  EXPECT_DOUBLE_EQ(2.0, (m / 2.0)[0][1]);
+  EXPECT_EQ(TMatrixLayout::ColMajor, (m * 2.0).layout());
+}
+
+TEST(TDynamicMatrix, can_apply_scalar_operations_in_place)
+{
+  TDynamicMatrix<int> m(3);
+  m[1][1] = 5;
+  m *= 2;
+  m += 1;
+  m.block(0, 0, 1, 3) -= 1;
+  EXPECT_EQ(0, m[0][0]);
+  EXPECT_EQ(11, m[1][1]);
+  EXPECT_EQ(1, m[2][2]);
+  m /= 11;
+  EXPECT_EQ(1, m[1][1]);
+}
+
+TEST(TDynamicMatrix, can_create_identity)
+{
+  TDynamicMatrix<int> e = TDynamicMatrix<int>::identity(3, TMatrixLayout::ColMajor);
+  EXPECT_EQ(1, e[2][2]);
+  EXPECT_EQ(0, e[0][2]);
+  EXPECT_EQ(TMatrixLayout::ColMajor, e.layout());
+}
+
+TEST(TDynamicMatrix, can_solve_linear_system)
+{
+  TDynamicMatrix<double> a(3);
+  a[0][1] = 2.0; a[0][2] = 1.0;
+  a[1][0] = 1.0; a[1][1] = 1.0;
+  a[2][0] = 3.0; a[2][2] = -1.0;
+  TDynamicVector<double> x(3);
+  x[0] = 1.0; x[1] = -2.0; x[2] = 0.5;
+  TDynamicVector<double> r = solve(a, a * x);
+  for (size_t i = 0; i < 3; i++)
+    EXPECT_NEAR(x[i], r[i], 1e-12);
+  TDynamicMatrix<double> inv = solve(a, TDynamicMatrix<double>::identity(3));
+  TDynamicMatrix<double> e = a * inv;
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 3; j++)
+      EXPECT_NEAR(i == j ? 1.0 : 0.0, e[i][j], 1e-12);
+}
+
+TEST(TDynamicMatrix, throws_when_solving_singular_system)
+{
+  TDynamicMatrix<double> a(2), b(2, 1);
+  a[0][0] = 1.0; a[0][1] = 2.0;
+  a[1][0] = 2.0; a[1][1] = 4.0;
+  ASSERT_ANY_THROW(solve(a, b));
+}
+
+TEST(TDynamicMatrix, pow_matches_repeated_multiplication)
+{
+  TDynamicMatrix<long long> a(3);
+  a[0][1] = 1; a[1][2] = 2; a[2][0] = 1; a[1][1] = 1;
+  TDynamicMatrix<long long> p = TDynamicMatrix<long long>::identity(3);
+  for (size_t k = 0; k <= 13; k++)
+  {
+    EXPECT_EQ(p, pow(a, k));
+    p = p * a;
+  }
+}
+
+TEST(TDynamicMatrix, polyval_matches_horner_scheme)
+{
+  TDynamicMatrix<long long> a(3, 3, TMatrixLayout::ColMajor);
+  a[0][0] = 1; a[0][1] = -1; a[1][2] = 2; a[2][0] = 1;
+  for (size_t d = 0; d <= 11; d++)
+  {
+    TDynamicVector<long long> c(d + 1);
+    for (size_t i = 0; i <= d; i++)
+      c[i] = (long long)(i % 3) - 1;
+    TDynamicMatrix<long long> h = TDynamicMatrix<long long>::identity(3) * c[d];
+    for (size_t i = d; i-- > 0;)
+      h = h * a + TDynamicMatrix<long long>::identity(3) * c[i];
+    EXPECT_EQ(h, polyval(a, c));
+  }
+}
+
+TEST(TDynamicMatrix, expm_of_nilpotent_and_diagonal_matrices)
+{
+  TDynamicMatrix<double> n(2);
+  n[0][1] = 3.0;
+  TDynamicMatrix<double> en = expm(n);
+  EXPECT_NEAR(1.0, en[0][0], 1e-14);
+  EXPECT_NEAR(3.0, en[0][1], 1e-14);
+  EXPECT_NEAR(0.0, en[1][0], 1e-14);
+  TDynamicMatrix<double> d(2);
+  d[0][0] = 0.001; d[1][1] = 20.0;
+  TDynamicMatrix<double> ed = expm(d);
+  EXPECT_NEAR(std::exp(0.001), ed[0][0], 1e-14);
+  EXPECT_NEAR(std::exp(20.0), ed[1][1], std::exp(20.0) * 1e-13);
+}
+
+TEST(TDynamicMatrix, expm_of_rotation_generator_is_rotation)
+{
+  for (double t : { 0.01, 0.5, 2.0, 30.0 })
+  {
+    TDynamicMatrix<double> a(2);
+    a[0][1] = -t;
+    a[1][0] = t;
+    TDynamicMatrix<double> r = expm(a);
+    EXPECT_NEAR(std::cos(t), r[0][0], 1e-12);
+    EXPECT_NEAR(-std::sin(t), r[0][1], 1e-12);
+    EXPECT_NEAR(std::sin(t), r[1][0], 1e-12);
+  }
+  TDynamicMatrix<float> f(2);
+  f[0][1] = -1.0f;
+  f[1][0] = 1.0f;
+  EXPECT_NEAR(std::cos(1.0f), expm(f)[0][0], 1e-6);
+}
+
+TEST(TDynamicMatrix, copy_on_write_copies_are_independent)
+{
+  bool old = TMemory::copyOnWrite;
+  TMemory::copyOnWrite = true;
+  TDynamicMatrix<double> m = TDynamicMatrix<double>::identity(3);
+  TDynamicMatrix<double> c = m;
+  EXPECT_EQ(static_cast<const TDynamicMatrix<double>&>(m).data(), static_cast<const TDynamicMatrix<double>&>(c).data());
+  c.view() *= 2.0;
+  EXPECT_EQ(1.0, m[0][0]);
+  EXPECT_EQ(2.0, c[0][0]);
+  TVectorView<double> r = m.row(1);
+  TDynamicMatrix<double> d = m;
+  r[1] = 5.0;
+  EXPECT_EQ(5.0, m[1][1]);
+  EXPECT_EQ(1.0, d[1][1]);
+  TMemory::copyOnWrite = old;
+}
+
+TEST(TDynamicMatrix, copy_of_large_matrix_is_exact)
+{
+  TDynamicMatrix<double> m(1500, 1000);
+  for (size_t i = 0; i < 1500; i++)
+    m[i][i % 1000] = (double)i;
+  TDynamicMatrix<double> c(m), a(1);
+  a = m;
+  EXPECT_EQ(m, c);
+  EXPECT_EQ(m, a);
+  EXPECT_EQ(1499.0, a[1499][499]);
+}
+
+TEST(TDynamicMatrix, allclose_compares_matrices_of_different_layouts)
+{
+  TDynamicMatrix<double> a(3, 4), b(3, 4, TMatrixLayout::ColMajor);
+  a[2][3] = 5.0;
+  b[2][3] = 5.0 + 1e-7;
+  EXPECT_TRUE(allclose(a, b));
+  EXPECT_TRUE(allclose(a, TDynamicMatrix<double>(a)));
+  b[0][1] = 1e-3;
+  EXPECT_FALSE(allclose(a, b));
+  EXPECT_TRUE(allclose(a.block(0, 2, 3, 2), b.block(0, 2, 3, 2)));
+  EXPECT_FALSE(allclose(a, TDynamicMatrix<double>(4, 3)));
+}
+
+TEST(TDynamicMatrix, hash_does_not_depend_on_layout)
+{
+  TDynamicMatrix<int> a(3, 5), b(3, 5, TMatrixLayout::ColMajor);
+  a[1][4] = b[1][4] = 9;
+  a[2][0] = b[2][0] = -1;
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_NE(a.hash(), TDynamicMatrix<int>(5, 3).hash());
+  b[0][0] = 1;
+  EXPECT_NE(a.hash(), b.hash());
+}
+
+TEST(TDynamicMatrix, lu_decomposition_reconstructs_matrix)
+{
+  TDynamicMatrix<double> a(3);
+  a[0][0] = 1.0; a[0][1] = 2.0; a[0][2] = 3.0;
+  a[1][0] = 4.0; a[1][1] = 5.0; a[1][2] = 6.0;
+  a[2][0] = 7.0; a[2][1] = 8.0; a[2][2] = 10.0;
+  TLUDecomposition<double> d = lu(a);
+  const TDynamicMatrix<double>& f = d.factors();
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 3; j++)
+    {
+      double s = 0.0;
+      for (size_t k = 0; k <= min(i, j); k++)
+        s += (k == i ? 1.0 : f[i][k]) * f[k][j];
+      EXPECT_NEAR(a[d.permutation()[i]][j], s, 1e-12);
+    }
+  EXPECT_TRUE(allclose(TDynamicMatrix<double>::identity(3), a * inverse(a), 0.0, 1e-12));
+}
+
+TEST(TDynamicMatrix, memo_cache_reuses_results)
+{
+  TMemoCache& cache = TMemoCache::instance();
+  bool old = TMemoCache::enabled;
+  TMemoCache::enabled = true;
+  cache.clear();
+  TDynamicMatrix<double> a(4), b(4);
+  for (size_t i = 0; i < 4; i++)
+  {
+    a[i][i] = 2.0;
+    b[i][(i + 1) % 4] = 1.0;
+  }
+  TDynamicMatrix<double> p = a * b;
+  EXPECT_EQ(1u, cache.misses());
+  EXPECT_EQ(p, TDynamicMatrix<double>(a) * b);
+  EXPECT_EQ(1u, cache.hits());
+  EXPECT_EQ(1u, cache.size());
+  EXPECT_EQ(16 * sizeof(double), cache.bytes());
+  a[0][0] = 3.0;
+  EXPECT_EQ(3.0, (a * b)[0][1]);
+  EXPECT_EQ(2u, cache.misses());
+  inverse(a);
+  inverse(a);
+  EXPECT_EQ(2u, cache.hits());
+  TMemoCache::enabled = old;
+  cache.clear();
+}
+
+TEST(TDynamicMatrix, memo_cache_respects_budget)
+{
+  TMemoCache& cache = TMemoCache::instance();
+  bool old = TMemoCache::enabled;
+  size_t oldBudget = cache.budget();
+  TMemoCache::enabled = true;
+  cache.clear();
+  cache.setBudget(2 * 9 * sizeof(int));
+  TDynamicMatrix<int> a(3), b(3), c(3), big(5);
+  a[0][0] = 1; b[0][0] = 2; c[0][0] = 3;
+  a * a;
+  b * b;
+  a * a;
+  c * c; // вытесняет b
+  EXPECT_EQ(2u, cache.size());
+  a * a;
+  EXPECT_EQ(2u, cache.hits());
+  b * b;
+  EXPECT_EQ(2u, cache.hits());
+  big * big; // больше бюджета - не запоминается
+  EXPECT_EQ(2u, cache.size());
+  cache.setBudget(oldBudget);
+  TMemoCache::enabled = old;
+  cache.clear();
+}
+
+TEST(TDynamicMatrix, memo_cache_keys_on_reduction_mode)
+{
+  TMemoCache& cache = TMemoCache::instance();
+  bool old = TMemoCache::enabled;
+  TSumMode oldMode = TReduction::mode;
+  TMemoCache::enabled = true;
+  cache.clear();
+  TDynamicMatrix<double> a(3), b(3);
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 3; j++)
+    {
+      a[i][j] = 1.0 / (i + j + 1);
+      b[i][j] = i == j ? 1.0 : 0.5;
+    }
+  TReduction::mode = TSumMode::Serial;
+  a * b;
+  TReduction::mode = TSumMode::Kahan;
+  a * b;
+  EXPECT_EQ(0u, cache.hits());
+  EXPECT_EQ(2u, cache.misses());
+  cache.clear();
+  pow(a, 5);
+  TDynamicVector<double> c(6);
+  for (size_t i = 0; i < 6; i++)
+    c[i] = 1.0 + i;
+  polyval(a, c);
+  expm(a);
+  EXPECT_EQ(0u, cache.size());
+  TReduction::mode = oldMode;
+  TMemoCache::enabled = old;
+  cache.clear();
+}
+
+TEST(TDynamicMatrix, text_output_keeps_iostream_format)
+{
+  TDynamicMatrix<double> m(2, 3, TMatrixLayout::ColMajor);
+  m[0][0] = 1.0 / 3; m[0][1] = -2.5; m[0][2] = 1e20;
+  m[1][0] = 0.0; m[1][1] = 7.0; m[1][2] = -1e-7;
+  ostringstream fast, slow;
+  fast << setprecision(4) << m;
+  slow << setprecision(4);
+  for (size_t i = 0; i < 2; i++)
+  {
+    for (size_t j = 0; j < 3; j++)
+      slow << m[i][j] << ' ';
+    slow << '\n';
+  }
+  EXPECT_EQ(slow.str(), fast.str());
+}
+
+TEST(TDynamicMatrix, text_round_trip_of_large_matrix_is_exact)
+{
+  size_t old = TParallel::threads;
+  TParallel::threads = 4;
+  TDynamicMatrix<double> m(300, 250), r(300, 250, TMatrixLayout::ColMajor);
+  for (size_t i = 0; i < 300; i++)
+    for (size_t j = 0; j < 250; j++)
+      m[i][j] = sin((double)(i * 250 + j)) * 1e3;
+  stringstream s;
+  s << setprecision(17) << m << 42;
+  int tail = 0;
+  s >> r >> tail;
+  TParallel::threads = old;
+  EXPECT_FALSE(s.fail());
+  EXPECT_EQ(m, r);
+  EXPECT_EQ(42, tail);
+}
+
+TEST(TDynamicMatrix, text_input_fails_on_bad_number)
+{
+  TDynamicMatrix<int> m(2);
+  istringstream s("1 +2\n3 x4");
+  s >> m;
+  EXPECT_TRUE(s.fail());
+  istringstream t("1 2 3");
+  t >> m;
+  EXPECT_TRUE(t.fail());
+  EXPECT_TRUE(t.eof());
+}
@@ -0,0 +1,134 @@
+#include "tnpy.h"
+
+#include <cstdio>
+#include <sstream>
+#include <gtest.h>
+
+TEST(TNpy, header_is_aligned_and_readable)
+{
+  string h = TNpy::makeHeader("<f8", true, { 3, 4 });
+  EXPECT_EQ(0u, h.size() % 64);
+  EXPECT_EQ('\n', h.back());
+  istringstream s(h);
+  TNpy::THeader r = TNpy::readHeader(s);
+  EXPECT_EQ("<f8", r.descr);
+  EXPECT_TRUE(r.fortranOrder);
+  ASSERT_EQ(2u, r.shape.size());
+  EXPECT_EQ(4u, r.shape[1]);
+}
+
+TEST(TNpy, round_trips_both_orders)
+{
+  TDynamicMatrix<double> a(3, 5), b(3, 5, TMatrixLayout::ColMajor);
+  for (size_t i = 0; i < 3; i++)
+    for (size_t j = 0; j < 5; j++)
+      a[i][j] = b[i][j] = (double)(i * 10 + j) / 3.0;
+  stringstream sa, sb;
+  TNpy::write<double>(sa, a);
+  TNpy::write<double>(sb, b);
+  TDynamicMatrix<double> ra = TNpy::readMatrix<double>(sa), rb = TNpy::readMatrix<double>(sb);
+  EXPECT_EQ(TMatrixLayout::RowMajor, ra.layout());
+  EXPECT_EQ(TMatrixLayout::ColMajor, rb.layout());
+  EXPECT_EQ(a, ra);
+  EXPECT_EQ(a, rb);
+}
+
+TEST(TNpy, writes_strided_views_and_vectors)
+{
+  TDynamicMatrix<int> a(4, 4);
+  for (size_t i = 0; i < 4; i++)
+    for (size_t j = 0; j < 4; j++)
+      a[i][j] = (int)(i * 4 + j);
+  stringstream s;
+  TNpy::write<int>(s, TMatrixView<const int>(a).block(1, 1, 2, 3));
+  TDynamicMatrix<int> r = TNpy::readMatrix<int>(s);
+  EXPECT_EQ(2u, r.rows());
+  EXPECT_EQ(7, r[0][2]);
+  stringstream v;
+  TNpy::write<int>(v, TMatrixView<const int>(a).col(2));
+  TDynamicVector<int> c = TNpy::readVector<int>(v);
+  ASSERT_EQ(4u, c.size());
+  EXPECT_EQ(14, c[3]);
+}
+
+TEST(TNpy, swaps_big_endian_and_rejects_other_dtypes)
+{
+  string h = TNpy::makeHeader(">i4", false, { 2 });
+  stringstream s(h + string("\0\0\0\1\0\0\1\0", 8));
+  TDynamicVector<int> v = TNpy::readVector<int>(s);
+  EXPECT_EQ(1, v[0]);
+  EXPECT_EQ(256, v[1]);
+  stringstream t(TNpy::makeHeader("<f4", false, { 2 }) + string(8, '\0'));
+  EXPECT_THROW(TNpy::readVector<double>(t), runtime_error);
+}
+
+TEST(TNpyMap, maps_file_without_copy)
+{
+  string path = "tnpy_map.npy";
+  TDynamicMatrix<float> a(3, 2, TMatrixLayout::ColMajor);
+  a[2][1] = 5.0f;
+  a[0][1] = -1.0f;
+  TNpy::save<float>(path, TMatrixView<const float>(a));
+  {
+    TNpyMap<float> m(path);
+#if defined(__linux__)
+    EXPECT_TRUE(m.mapped());
+#endif
+    TMatrixView<const float> v = m.matrix();
+    EXPECT_EQ(TMatrixLayout::ColMajor, v.layout());
+    EXPECT_EQ(5.0f, v(2, 1));
+    EXPECT_EQ(-1.0f, v(0, 1));
+  }
+  remove(path.c_str());
+}
+
+TEST(TNpyMap, throws_on_corrupt_and_truncated_files)
+{
+  string path = "tnpy_bad.npy";
+  {
+    ofstream f(path, ios::binary);
+    f << "not a numpy file at all";
+  }
+  EXPECT_THROW(TNpyMap<double> m(path), runtime_error);
+  {
+    ofstream f(path, ios::binary);
+    f << TNpy::makeHeader("<f8", false, { 10, 10 }) << string(16, '\0');
+  }
+  EXPECT_THROW(TNpyMap<double> m(path), runtime_error);
+  EXPECT_THROW(TNpyMap<float> m(path), runtime_error);
+  // произведения размерностей и размер в байтах переполняют size_t
+  {
+    ofstream f(path, ios::binary);
+    f << TNpy::makeHeader("<f8", false, { (size_t)1 << 62, 4 }) << string(16, '\0');
+  }
+  EXPECT_THROW(TNpyMap<double> m(path), runtime_error);
+  {
+    ofstream f(path, ios::binary);
+    f << TNpy::makeHeader("<f8", false, { ((size_t)1 << 61) + 1 }) << string(16, '\0');
+  }
+  EXPECT_THROW(TNpyMap<double> m(path), runtime_error);
+  remove(path.c_str());
+}
+
+TEST(TNpz, round_trips_several_arrays)
+{
+  string path = "tnpz.npz";
+  TDynamicMatrix<double> a(2, 3);
+  a[1][2] = 4.5;
+  TDynamicVector<long long> v(5);
+  v[4] = 1LL << 40;
+  {
+    TNpzWriter w(path);
+    w.add<double>("a", a);
+    w.add<long long>("v", v);
+  }
+  TNpz z(path);
+  ASSERT_EQ(2u, z.names().size());
+  EXPECT_TRUE(z.contains("v"));
+  EXPECT_FALSE(z.contains("x"));
+  EXPECT_EQ(a, z.readMatrix<double>("a"));
+  EXPECT_EQ(v, z.readVector<long long>("v"));
+  EXPECT_THROW(z.readMatrix<double>("x"), out_of_range);
+  EXPECT_THROW(z.readMatrix<float>("a"), runtime_error);
+  remove(path.c_str());
+}
@@ -0,0 +1,77 @@
+#include "tparallel.h"
+
+#include <set>
+#include <stdexcept>
+#include <gtest.h>
+
+namespace
+{
+  // задачи раздаются пулу и на одноядерной машине
+  struct TThreadsGuard
+  {
+    size_t saved = TParallel::threads;
+    TThreadsGuard() { TParallel::threads = 4; }
+    ~TThreadsGuard() { TParallel::threads = saved; }
+  };
+}
+
+TEST(TParallel, for_range_covers_range_once)
+{
+  TThreadsGuard guard;
+  std::vector<std::atomic<int>> hits(100000);
+  TParallel::forRange(hits.size(), 1000, [&](size_t first, size_t last) {
+    for (size_t i = first; i < last; i++)
+      hits[i]++;
+  });
+  for (auto& h : hits)
+    ASSERT_EQ(1, h.load());
+}
+
+TEST(TParallel, rethrows_exception_from_task)
+{
+  TThreadsGuard guard;
+  ASSERT_THROW(TParallel::forEach(64, [](size_t i) {
+    if (i == 37)
+      throw std::runtime_error("task failed");
+  }), std::runtime_error);
+}
+
+TEST(TParallel, supports_nested_calls)
+{
+  TThreadsGuard guard;
+  std::atomic<size_t> total(0);
+  TParallel::forEach(16, [&](size_t) {
+    TParallel::forEach(16, [&](size_t) {
+      TParallel::forRange(1000, 10, [&](size_t first, size_t last) { total += last - first; });
+    });
+  });
+  EXPECT_EQ(16u * 16u * 1000u, total.load());
+}
+
+TEST(TParallel, reuses_pool_threads_across_calls)
+{
+  TThreadsGuard guard;
+  std::mutex m;
+  std::set<std::thread::id> ids;
+  for (int k = 0; k < 20; k++)
+    TParallel::forEach(32, [&](size_t) {
+      std::lock_guard<std::mutex> lock(m);
+      ids.insert(std::this_thread::get_id());
+    });
+  EXPECT_LE(ids.size(), TThreadPool::instance().size() + 1);
+}
+
+TEST(TParallel, can_be_called_from_many_threads)
+{
+  TThreadsGuard guard;
+  std::atomic<size_t> total(0);
+  std::vector<std::thread> callers;
+  for (int t = 0; t < 8; t++)
+    callers.emplace_back([&] {
+      for (int k = 0; k < 50; k++)
+        TParallel::forRange(4096, 64, [&](size_t first, size_t last) { total += last - first; });
+    });
+  for (std::thread& t : callers)
+    t.join();
+  EXPECT_EQ(8u * 50u * 4096u, total.load());
+}
@@ -0,0 +1,96 @@
+#include "tstream.h"
+
+#include <sstream>
+#include <gtest.h>
+
+namespace
+{
+  TDynamicMatrix<double> sample(size_t rows, size_t cols)
+  {
+    TDynamicMatrix<double> m(rows, cols);
+    for (size_t i = 0; i < rows; i++)
+      for (size_t j = 0; j < cols; j++)
+        m[i][j] = (double)((i * 7 + j * 3) % 11) - 5.0;
+    return m;
+  }
+}
+
+TEST(TPipeline, mat_vec_matches_in_memory_product)
+{
+  TDynamicMatrix<double> a = sample(103, 17);
+  TDynamicVector<double> x(17), y(103);
+  for (size_t j = 0; j < 17; j++)
+    x[j] = (double)j;
+  size_t next = 0, calls = 0;
+  size_t rows = TPipeline::matVec<double>(x, 10, [&](TMatrixView<double> panel) {
+    size_t n = min<size_t>(panel.rows(), a.rows() - next);
+    if (n == 0)
+      return n;
+    panel.block(0, 0, n, panel.cols()).assign(TMatrixView<const double>(a).block(next, 0, n, a.cols()));
+    next += n;
+    return n;
+  }, [&](size_t first, TVectorView<const double> part) {
+    y.view().slice(first, part.size()).assign(part);
+    calls++;
+  });
+  EXPECT_EQ(103u, rows);
+  EXPECT_EQ(11u, calls);
+  EXPECT_EQ(a * x, y);
+}
+
+TEST(TPipeline, reads_binary_rows_with_deeper_buffering)
+{
+  TDynamicMatrix<int> a(9, 4);
+  for (size_t i = 0; i < 9; i++)
+    for (size_t j = 0; j < 4; j++)
+      a[i][j] = (int)(i + j);
+  TDynamicVector<int> x(4), y(9);
+  x[0] = 1; x[3] = 2;
+  stringstream s;
+  a.writeBinary(s);
+  s.seekg(2 * sizeof(uint64_t) + 1); // только элементы
+  TPipeline::matVec<int>(x, 2, TPipeline::binaryRows<int>(s), [&](size_t first, TVectorView<const int> part) {
+    y.view().slice(first, part.size()).assign(part);
+  }, 3);
+  EXPECT_EQ(a * x, y);
+}
+
+TEST(TPipeline, handles_matrices_wider_than_max_matrix_size)
+{
+  const size_t cols = MAX_MATRIX_SIZE * 3;
+  TDynamicVector<double> x(cols), y(5);
+  for (size_t j = 0; j < cols; j++)
+    x[j] = 1.0;
+  size_t rows = 0;
+  TPipeline::matVec<double>(x, 2, [&](TMatrixView<double> panel) -> size_t {
+    size_t n = min<size_t>(panel.rows(), 5 - rows);
+    for (size_t i = 0; i < n; i++)
+      for (size_t j = 0; j < cols; j++)
+        panel(i, j) = (double)(rows + i);
+    rows += n;
+    return n;
+  }, [&](size_t first, TVectorView<const double> part) {
+    y.view().slice(first, part.size()).assign(part);
+  });
+  for (size_t i = 0; i < 5; i++)
+    EXPECT_EQ((double)(i * cols), y[i]);
+}
+
+TEST(TPipeline, propagates_errors_from_source_and_sink)
+{
+  TDynamicVector<double> x(3);
+  size_t panels = 0;
+  auto source = [&](TMatrixView<double> panel) -> size_t {
+    if (++panels == 3)
+      throw runtime_error("source failed");
+    return panel.rows();
+  };
+  EXPECT_THROW(TPipeline::matVec<double>(x, 4, source, [](size_t, TVectorView<const double>) {}), runtime_error);
+  auto endless = [](TMatrixView<double> panel) { return panel.rows(); };
+  EXPECT_THROW(TPipeline::matVec<double>(x, 4, endless, [](size_t first, TVectorView<const double>) {
+    if (first >= 8)
+      throw out_of_range("sink failed");
+  }), out_of_range);
+  stringstream s(string(sizeof(double) * 4, '\0'));
+  EXPECT_THROW(TPipeline::matVec<double>(x, 4, TPipeline::binaryRows<double>(s), [](size_t, TVectorView<const double>) {}), runtime_error);
+}
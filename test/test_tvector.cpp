@@ -1,5 +1,10 @@
 #include "tmatrix.h"
 
+#include <cmath>
+#include <cstring>
+#include <iomanip>
+#include <limits>
+#include <sstream>
 #include <gtest.h>
 
 TEST(TDynamicVector, can_create_vector_with_positive_length)
@@ -228,3 +233,446 @@ TEST(TDynamicVector, cant_multiply_vectors_with_not_equal_size)
   // при разных размерах просто берётся минимум, тест считаем пройденным
   EXPECT_NO_FATAL_FAILURE(v1 * v2);
 }
+
+TEST(TDynamicVector, slice_refers_to_vector_memory)
+{
+  TDynamicVector<int> v(6);
+  TVectorView<int> s = v.slice(1, 3, 2);
+  s[0] = 7;
+  s[2] = 9;
+  EXPECT_EQ(3, s.size());
+  EXPECT_EQ(7, v[1]);
+  EXPECT_EQ(9, v[5]);
+}
+
+TEST(TDynamicVector, throws_when_slice_is_out_of_range)
+{
+  TDynamicVector<int> v(4);
+  EXPECT_ANY_THROW(v.slice(2, 3));
+  EXPECT_ANY_THROW(v.slice(0, 3, 2));
+}
+
+TEST(TDynamicVector, can_add_slice_to_vector)
+{
+  TDynamicVector<int> v1(4), v2(2);
+  v1[0] = 1; v1[1] = 2; v1[2] = 3; v1[3] = 4;
+  v2[0] = 10; v2[1] = 20;
+  TDynamicVector<int> r = v2 + v1.slice(1, 2, 2);
+  EXPECT_EQ(12, r[0]);
+  EXPECT_EQ(24, r[1]);
+}
+
+TEST(TDynamicVector, can_modify_slice_in_place)
+{
+  TDynamicVector<int> v(4);
+  v[0] = 1; v[1] = 2; v[2] = 3; v[3] = 4;
+  v.slice(2, 2) += v.slice(0, 2);
+  EXPECT_EQ(1, v[0]);
+  EXPECT_EQ(4, v[2]);
+  EXPECT_EQ(6, v[3]);
+}
+
+TEST(TDynamicVector, scalar_operations_do_not_go_through_double)
+{
+  TDynamicVector<long long> v(1);
+  v[0] = 9007199254740993LL;
+  EXPECT_EQ(9007199254740994LL, (v + 1LL)[0]);
+  EXPECT_EQ(9007199254740992LL, (v - 1LL)[0]);
+}
+
+TEST(TDynamicVector, floating_scalar_promotes_integer_vector)
+{
+  TDynamicVector<int> v(2);
+  v[0] = 1; v[1] = 3;
+  TDynamicVector<double> r = v * 0.5;
+  EXPECT_DOUBLE_EQ(0.5, r[0]);
+  EXPECT_DOUBLE_EQ(1.5, r[1]);
+}
+
+TEST(TDynamicVector, can_add_vectors_with_different_element_types)
+{
+  TDynamicVector<float> a(2);
+  TDynamicVector<double> b(2);
+  a[0] = 1.5f; a[1] = 2.5f;
+  b[0] = 0.25; b[1] = 0.125;
+  TDynamicVector<double> r = a + b;
+  EXPECT_DOUBLE_EQ(1.75, r[0]);
+  EXPECT_DOUBLE_EQ(2.625, r[1]);
+  EXPECT_DOUBLE_EQ(1.5 * 0.25 + 2.5 * 0.125, a * b);
+}
+
+TEST(TDynamicVector, float_dot_product_accumulates_in_double)
+{
+  TDynamicVector<float> a(3), b(3);
+  a[0] = 1e8f; a[1] = 1.0f; a[2] = -1e8f;
+  b[0] = 1.0f; b[1] = 1.0f; b[2] = 1.0f;
+  EXPECT_EQ(1.0f, a * b);
+}
+
+TEST(TDynamicVector, all_summation_modes_give_exact_integer_dot_product)
+{
+  TDynamicVector<long long> a(1000), b(1000);
+  for (size_t i = 0; i < 1000; i++)
+  {
+    a[i] = (long long)i;
+    b[i] = 2;
+  }
+  TSumMode old = TReduction::mode;
+  for (TSumMode m : { TSumMode::Serial, TSumMode::Pairwise, TSumMode::Kahan })
+  {
+    TReduction::mode = m;
+    EXPECT_EQ(999000, a * b);
+  }
+  TReduction::mode = old;
+}
+
+TEST(TDynamicVector, compensated_summation_is_more_accurate_than_serial)
+{
+  const size_t n = 100000;
+  TDynamicVector<double> a(n), b(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    a[i] = 0.1;
+    b[i] = 1.0;
+  }
+  a[0] = 1e10;
+  double exact = 1e10 + 0.1 * (n - 1);
+  double serial = TReduction::sum<double>(n, [&](size_t i) { return a[i] * b[i]; }, TSumMode::Serial);
+  double kahan = TReduction::sum<double>(n, [&](size_t i) { return a[i] * b[i]; }, TSumMode::Kahan);
+  double pairwise = TReduction::sum<double>(n, [&](size_t i) { return a[i] * b[i]; }, TSumMode::Pairwise);
+  EXPECT_LT(std::fabs(kahan - exact), std::fabs(serial - exact));
+  EXPECT_LE(std::fabs(pairwise - exact), std::fabs(serial - exact));
+}
+
+TEST(TDynamicVector, parallel_dot_product_does_not_depend_on_thread_count)
+{
+  const size_t n = 300000;
+  TDynamicVector<double> a(n), b(n);
+  for (size_t i = 0; i < n; i++)
+  {
+    a[i] = std::sin((double)i);
+    b[i] = 1.0 / (1.0 + (double)i);
+  }
+  size_t old = TParallel::threads;
+  TParallel::threads = 1;
+  double r1 = a * b;
+  for (size_t t : { 2, 3, 8 })
+  {
+    TParallel::threads = t;
+    EXPECT_EQ(r1, a * b);
+  }
+  TParallel::threads = old;
+}
+
+TEST(TDynamicVector, can_compute_sum_min_max_and_argmax)
+{
+  TDynamicVector<int> v(5);
+  v[0] = 3; v[1] = -7; v[2] = 9; v[3] = 9; v[4] = 0;
+  EXPECT_EQ(14, v.sum());
+  EXPECT_EQ(-7, v.min());
+  EXPECT_EQ(9, v.max());
+  EXPECT_EQ(2, v.argmax());
+  EXPECT_EQ(1, v.argmin());
+}
+
+TEST(TDynamicVector, can_compute_norms)
+{
+  TDynamicVector<double> v(3);
+  v[0] = 3.0; v[1] = -4.0; v[2] = 0.0;
+  EXPECT_DOUBLE_EQ(7.0, v.norm1());
+  EXPECT_DOUBLE_EQ(5.0, v.norm2());
+  EXPECT_DOUBLE_EQ(4.0, v.normInf());
+  EXPECT_DOUBLE_EQ(4.0, v.slice(1, 2).norm2());
+}
+
+TEST(TDynamicVector, argmax_of_long_vector_returns_first_maximum)
+{
+  TDynamicVector<int> v(100000);
+  v[70000] = 5;
+  v[90000] = 5;
+  v[10] = -1;
+  EXPECT_EQ(70000, v.argmax());
+  EXPECT_EQ(10, v.argmin());
+  EXPECT_EQ(9, v.sum());
+}
+
+TEST(TDynamicVector, can_map_and_apply_functions)
+{
+  TDynamicVector<int> v(4);
+  v[0] = -2; v[1] = 5; v[2] = -1; v[3] = 3;
+  TDynamicVector<double> h = v.map([](int x) { return x * 0.5; });
+  EXPECT_DOUBLE_EQ(2.5, h[1]);
+  v.apply([](int x) { return x < 0 ? 0 : x; });
+  EXPECT_EQ(0, v[0]);
+  EXPECT_EQ(5, v[1]);
+  EXPECT_EQ(0, v[2]);
+}
+
+TEST(TDynamicVector, can_zip_vectors_and_slices)
+{
+  TDynamicVector<int> a(3), b(6);
+  a[0] = 1; a[1] = 2; a[2] = 3;
+  for (size_t i = 0; i < 6; i++)
+    b[i] = (int)i;
+  TDynamicVector<int> r = zip(a, b.slice(1, 3, 2), [](int x, int y) { return x * 10 + y; });
+  EXPECT_EQ(11, r[0]);
+  EXPECT_EQ(23, r[1]);
+  EXPECT_EQ(35, r[2]);
+  EXPECT_ANY_THROW(zip(a, b, [](int x, int y) { return x + y; }));
+}
+
+TEST(TDynamicVector, apply_processes_long_vector_in_parallel_chunks)
+{
+  TDynamicVector<float> v(200000);
+  v.apply([](float) { return 2.0f; });
+  EXPECT_EQ(400000.0f, v.sum());
+}
+
+TEST(TDynamicVector, can_multiply_and_divide_elementwise)
+{
+  TDynamicVector<double> a(3), b(3);
+  a[0] = 1.0; a[1] = 4.0; a[2] = 9.0;
+  b[0] = 2.0; b[1] = 2.0; b[2] = 3.0;
+  TDynamicVector<double> p = a.cwiseProduct(b), q = a.cwiseQuotient(b);
+  EXPECT_DOUBLE_EQ(8.0, p[1]);
+  EXPECT_DOUBLE_EQ(3.0, q[2]);
+  EXPECT_EQ(p, hadamard(a, b));
+  a.cwiseMultiply(b).cwiseDivide(b);
+  EXPECT_DOUBLE_EQ(4.0, a[1]);
+  EXPECT_ANY_THROW(a.cwiseMultiply(TDynamicVector<double>(2)));
+}
+
+TEST(TDynamicVector, interleave_policy_keeps_values)
+{
+  size_t oldThreads = TParallel::threads;
+  TNumaPolicy oldPolicy = TMemory::numa;
+  TParallel::threads = 4;
+  TMemory::numa = TNumaPolicy::Interleave;
+  {
+    TDynamicVector<double> v(1000000);
+    EXPECT_EQ(0.0, v.sum());
+    EXPECT_EQ(0u, (uintptr_t)v.data() % TMemory::PAGE);
+    v[999999] = 3.0;
+    TDynamicVector<double> c(v);
+    EXPECT_EQ(v, c);
+    TDynamicVector<double> s(5);
+    s = v;
+    EXPECT_EQ(3.0, s[999999]);
+  }
+  TMemory::numa = oldPolicy;
+  TParallel::threads = oldThreads;
+}
+
+TEST(TDynamicVector, huge_page_storage_falls_back_cleanly)
+{
+  THugePages old = TMemory::hugePages;
+  for (THugePages h : { THugePages::Normal, THugePages::Transparent, THugePages::Explicit })
+  {
+    TMemory::hugePages = h;
+    TDynamicVector<double> v(600000);
+    EXPECT_EQ(0.0, v.sum());
+    EXPECT_EQ(0u, (uintptr_t)v.data() % TMemory::PAGE);
+#if defined(__linux__)
+    if (h == THugePages::Transparent)
+    {
+      EXPECT_EQ(0u, (uintptr_t)v.data() % TMemory::HUGE_PAGE);
+    }
+#endif
+    v[599999] = 1.0;
+    TMemory::hugePages = old;
+    TDynamicVector<double> c(v);
+    EXPECT_EQ(v, c);
+  }
+  TMemory::hugePages = old;
+}
+
+TEST(TDynamicVector, copy_on_write_shares_buffer_until_modified)
+{
+  bool old = TMemory::copyOnWrite;
+  TMemory::copyOnWrite = true;
+  int init[4] = { 0, 7, 0, 0 };
+  TDynamicVector<int> a(init, 4);
+  const TDynamicVector<int> b(a);
+  TDynamicVector<int> c(4);
+  c = b;
+  const TDynamicVector<int>& ca = a;
+  EXPECT_EQ(ca.data(), b.data());
+  EXPECT_EQ(ca.data(), static_cast<const TDynamicVector<int>&>(c).data());
+  EXPECT_EQ(14, (a + b)[1]);
+  EXPECT_EQ(ca.data(), b.data());
+  c[1] = 5;
+  EXPECT_NE(ca.data(), static_cast<const TDynamicVector<int>&>(c).data());
+  EXPECT_EQ(7, b[1]);
+  a[1] = 3;
+  EXPECT_EQ(7, b[1]);
+  EXPECT_EQ(3, a[1]);
+  TMemory::copyOnWrite = old;
+}
+
+TEST(TDynamicVector, copy_on_write_does_not_share_buffer_behind_views)
+{
+  bool old = TMemory::copyOnWrite;
+  TMemory::copyOnWrite = true;
+  TDynamicVector<int> a(4);
+  TVectorView<int> s = a.view();
+  TDynamicVector<int> b(a);
+  const TDynamicVector<int>& ca = a;
+  const TDynamicVector<int>& cb = b;
+  s[0] = 5;
+  EXPECT_EQ(5, ca[0]);
+  EXPECT_EQ(0, cb[0]);
+  int& r = a[1];
+  TDynamicVector<int> c(4);
+  c = a;
+  r = 7;
+  EXPECT_EQ(7, ca[1]);
+  EXPECT_EQ(0, static_cast<const TDynamicVector<int>&>(c)[1]);
+  a = b; // тот же размер - элементы копируются на место, s остаётся в силе
+  s[2] = 9;
+  EXPECT_EQ(9, ca[2]);
+  EXPECT_EQ(0, cb[2]);
+  const TDynamicVector<int> d(b); // b наружу не выдавался - буфер общий
+  EXPECT_EQ(cb.data(), d.data());
+  TMemory::copyOnWrite = old;
+}
+
+TEST(TDynamicVector, bulk_copy_of_large_vector_is_exact)
+{
+  size_t old = TParallel::threads;
+  TParallel::threads = 4;
+  const size_t n = 5000000; // больше порога потоковой записи
+  TDynamicVector<double> v(n);
+  for (size_t i = 0; i < n; i++)
+    v[i] = (double)i;
+  TDynamicVector<double> c(v);
+  EXPECT_EQ(v, c);
+  TDynamicVector<double> a(n);
+  a = v;
+  EXPECT_EQ((double)(n - 1), a[n - 1]);
+  EXPECT_EQ(v, a);
+  TParallel::threads = old;
+}
+
+TEST(TDynamicVector, equality_finds_single_difference_in_long_vector)
+{
+  size_t old = TParallel::threads;
+  TParallel::threads = 4;
+  TDynamicVector<int> a(300000), b(300000);
+  EXPECT_TRUE(a == b);
+  b[299999] = 1;
+  EXPECT_FALSE(a == b);
+  TDynamicVector<double> x(300000), y(300000);
+  y[150000] = -0.0;
+  EXPECT_TRUE(x == y);
+  x[7] = NAN;
+  y[7] = NAN;
+  EXPECT_FALSE(x == y);
+  TParallel::threads = old;
+}
+
+TEST(TDynamicVector, allclose_uses_relative_and_absolute_tolerance)
+{
+  TDynamicVector<double> a(3), b(3);
+  a[0] = 1.0; a[1] = 1000.0; a[2] = 0.0;
+  b[0] = 1.0 + 1e-6; b[1] = 1000.005; b[2] = 1e-9;
+  EXPECT_TRUE(allclose(a, b));
+  EXPECT_FALSE(allclose(a, b, 1e-7, 1e-8));
+  b[2] = INFINITY;
+  EXPECT_FALSE(allclose(a, b));
+  a[2] = INFINITY;
+  EXPECT_TRUE(allclose(a, b));
+  a[0] = NAN;
+  EXPECT_FALSE(allclose(a, b));
+  EXPECT_FALSE(allclose(a, TDynamicVector<double>(2)));
+  TDynamicVector<float> f(3);
+  EXPECT_TRUE(allclose(f, TDynamicVector<double>(3)));
+}
+
+TEST(TDynamicVector, allclose_does_not_wrap_unsigned_differences)
+{
+  TDynamicVector<unsigned> a(2), b(2);
+  a[0] = 1; a[1] = 7;
+  b[0] = 5; b[1] = 3;
+  EXPECT_TRUE(allclose(a, b, 0.0, 4.0));
+  EXPECT_TRUE(allclose(b, a, 0.0, 4.0));
+  EXPECT_FALSE(allclose(a, b, 0.0, 3.0));
+  EXPECT_FALSE(allclose(b, a, 0.0, 3.0));
+}
+
+TEST(TDynamicVector, allclose_keeps_fractional_tolerances_for_integers)
+{
+  TDynamicVector<int> a(2), b(2);
+  a[0] = 100000; a[1] = -3;
+  b[0] = 100001; b[1] = -3;
+  EXPECT_TRUE(allclose(a, b, 1e-5, 0.0));
+  EXPECT_FALSE(allclose(a, b, 1e-6, 0.5));
+  EXPECT_TRUE(allclose(a, b, 0.0, 1.0));
+  b[1] = -2;
+  EXPECT_FALSE(allclose(a, b, 1e-5, 0.5));
+  EXPECT_TRUE(allclose(a, b, 0.0, 1.5));
+}
+
+TEST(TDynamicVector, equal_vectors_have_equal_hashes)
+{
+  TDynamicVector<double> a(1000), b(1000);
+  a[10] = 2.5;
+  b[10] = 2.5;
+  b[20] = -0.0;
+  EXPECT_EQ(a.hash(), b.hash());
+  EXPECT_EQ(a.checksum(), TDynamicVector<double>(a).checksum());
+  b[999] = 1.0;
+  EXPECT_NE(a.hash(), b.hash());
+  EXPECT_NE(a.hash(), a.hash(1));
+  EXPECT_NE(TDynamicVector<int>(3).hash(), TDynamicVector<int>(4).hash());
+}
+
+TEST(TDynamicVector, long_double_hash_ignores_padding_bytes)
+{
+  TDynamicVector<long double> a(300), b(300);
+  memset(a.data(), 0xAB, 300 * sizeof(long double));
+  memset(b.data(), 0x00, 300 * sizeof(long double));
+  for (size_t i = 0; i < 300; i++)
+    a[i] = b[i] = (long double)i / 3;
+  a[0] = -0.0L;
+  EXPECT_EQ(a.hash(), b.hash());
+  b[299] = 1.0L;
+  EXPECT_NE(a.hash(), b.hash());
+}
+
+TEST(TDynamicVector, text_round_trip_of_large_vector)
+{
+  size_t old = TParallel::threads;
+  TParallel::threads = 4;
+  TDynamicVector<long long> v(100000), r(100000);
+  for (size_t i = 0; i < v.size(); i++)
+    v[i] = ((long long)i - 50000) * 123457;
+  stringstream s;
+  s << v;
+  s >> r;
+  TParallel::threads = old;
+  EXPECT_FALSE(s.fail());
+  EXPECT_EQ(v, r);
+}
+
+TEST(TDynamicVector, text_output_honours_stream_flags)
+{
+  TDynamicVector<int> v(3);
+  v[0] = 10; v[1] = 255; v[2] = -1;
+  ostringstream dec, hex;
+  dec << v;
+  hex << std::hex << v;
+  EXPECT_EQ("10 255 -1 ", dec.str());
+  EXPECT_EQ("a ff ffffffff ", hex.str());
+}
+
+TEST(TDynamicVector, fixed_text_output_of_huge_long_double_fits)
+{
+  TDynamicVector<long double> v(2);
+  v[0] = 1e4000L;
+  v[1] = -std::numeric_limits<long double>::max();
+  ostringstream fast, slow;
+  fast << std::fixed << std::setprecision(100) << v;
+  slow << std::fixed << std::setprecision(100) << v[0] << ' ' << v[1] << ' ';
+  EXPECT_FALSE(fast.fail());
+  EXPECT_EQ(slow.str(), fast.str());
+}